@@ -0,0 +1,235 @@
+/******************************************************************************
+ * autotune.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "succinct_tree.h"
+#include "batch_queries.h"
+#include "util.h"
+#include "basic.h"
+
+/*
+ * Tuning of the parameters of st_conf. The benchmarks run on a sample of the
+ * input: its first 'sample' parentheses, closed with enough ')' to be
+ * balanced. The cost of a configuration is the time of one construction plus
+ * the time of a batch of find_close on random opening parentheses (one query
+ * every QUERY_RATIO parentheses):
+ * 1. For each number of workers (powers of two up to P, and P) and each chunk
+ *    size, with the default grains
+ * 2. For the best of 1., the grain of the construction (build_tasks) and of
+ *    the queries (query_tasks, interleave)
+ * The best configuration is written to the profile. Each time is the minimum
+ * of 'repeats' runs.
+ */
+
+#define QUERY_RATIO 4
+
+static double wall_time() {
+  struct timespec t;
+  if (clock_gettime(CLOCK_MONOTONIC, &t)) {
+    fprintf(stderr, "clock_gettime failed");
+    exit(-1);
+  }
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+// The Cilk runtime must be stopped to change its number of workers
+static void set_workers(int p) {
+#ifndef NOPARALLEL
+  char workers[16];
+  snprintf(workers, sizeof(workers), "%d", p);
+  __cilkrts_end_cilk();
+  if(__cilkrts_set_param("nworkers", workers) != 0) {
+    fprintf(stderr, "Error: Cannot set %d workers\n", p);
+    exit(EXIT_FAILURE);
+  }
+#endif
+}
+
+// Candidates for the number of workers: 1, 2, 4, ..., and max_workers
+static int next_workers(int p, int max_workers) {
+  if(p == max_workers)
+    return p + 1;
+  return min(2*p, max_workers);
+}
+
+// First 'len' parentheses of B, followed by the ')' that close them
+static BIT_ARRAY* sample_input(BIT_ARRAY* B, unsigned long len, unsigned long* n) {
+  BIT_ARRAY* prefix = bit_array_create(len);
+  bit_array_copy_range(prefix, 0, B, 0, len);
+  long excess = 2*(long)bit_array_and_count(NULL, prefix, prefix) - (long)len;
+  bit_array_free(prefix);
+
+  *n = len + max(excess, 0);
+  BIT_ARRAY* S = bit_array_create(*n); // The new bits are ')'
+  bit_array_copy_range(S, 0, B, 0, len);
+  return S;
+}
+
+static double time_build(BIT_ARRAY* S, unsigned long n, int repeats) {
+  double best = 0;
+  for(int r = 0; r < repeats; r++) {
+    double time = wall_time();
+    rmMt* st = st_create(S, n);
+    time = wall_time() - time;
+    st_free(st);
+    if(r == 0 || time < best)
+      best = time;
+  }
+  return best;
+}
+
+static double time_queries(rmMt* st, int32_t* pos, unsigned long m,
+			   int32_t* out, int repeats) {
+  double best = 0;
+  for(int r = 0; r < repeats; r++) {
+    double time = wall_time();
+    find_close_batch_interleaved(st, pos, m, out);
+    time = wall_time() - time;
+    if(r == 0 || time < best)
+      best = time;
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+
+  if(argc < 2) {
+    fprintf(stderr, "Usage: %s <input parentheses sequence> [profile] [sample size] [repeats] [max workers]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  const char* profile = (argc > 2) ? argv[2] : ST_PROFILE_FILE;
+  unsigned long sample = (argc > 3) ? atol(argv[3]) : 1UL << 24;
+  int repeats = (argc > 4) ? atoi(argv[4]) : 3;
+  int max_workers = (argc > 5) ? atoi(argv[5]) : threads;
+#ifdef NOPARALLEL
+  max_workers = 1;
+#endif
+
+  // The profile in use (if any) is loaded now, so it does not override the
+  // candidates later
+  st_config_init();
+
+  long len;
+  BIT_ARRAY *B = parentheses_to_bits(argv[1], &len);
+  unsigned long n;
+  BIT_ARRAY *S = sample_input(B, min((unsigned long)len, sample), &n);
+  bit_array_free(B);
+
+  unsigned long m = n/QUERY_RATIO;
+  int32_t* pos = (int32_t*)malloc(m*sizeof(int32_t));
+  int32_t* out = (int32_t*)malloc(m*sizeof(int32_t));
+  srand(1);
+  for(unsigned long q = 0; q < m; ) {
+    int32_t i = ((unsigned long)rand()*RAND_MAX + rand()) % n;
+    if(bit_array_get_bit(S, i))
+      pos[q++] = i;
+  }
+
+  st_config best = {LOG_S, 1, 1, INTERLEAVED_QUERIES, 0};
+  double best_cost = -1;
+
+  printf("workers,log_s,build_tasks,query_tasks,interleave,build_time,query_time\n");
+
+  /*
+   * STEP 1: Workers and chunk size
+   */
+  for(int p = 1; p <= max_workers; p = next_workers(p, max_workers)) {
+    set_workers(p);
+    for(unsigned int log_s = ST_MIN_LOG_S; log_s <= 12; log_s++) {
+      st_config conf = {log_s, 1, 1, INTERLEAVED_QUERIES, p};
+      st_conf = conf;
+
+      double build = time_build(S, n, repeats);
+      rmMt* st = st_create(S, n);
+      double query = time_queries(st, pos, m, out, repeats);
+      st_free(st);
+
+      printf("%d,%u,%u,%u,%u,%lf,%lf\n", p, log_s, conf.build_tasks,
+	     conf.query_tasks, conf.interleave, build, query);
+      if(best_cost < 0 || build + query < best_cost) {
+	best_cost = build + query;
+	best = conf;
+      }
+    }
+  }
+
+  /*
+   * STEP 2: Grains of the construction and of the queries
+   */
+  set_workers(best.workers);
+  st_conf = best;
+  double best_build = -1;
+  for(unsigned int tasks = 1; tasks <= 16; tasks *= 2) {
+    st_conf.build_tasks = tasks;
+    double build = time_build(S, n, repeats);
+    printf("%u,%u,%u,%u,%u,%lf,\n", best.workers, best.log_s, tasks,
+	   best.query_tasks, best.interleave, build);
+    if(best_build < 0 || build < best_build) {
+      best_build = build;
+      best.build_tasks = tasks;
+    }
+  }
+
+  st_conf = best;
+  rmMt* st = st_create(S, n);
+  double best_query = -1;
+  for(unsigned int tasks = 1; tasks <= 8; tasks *= 2) {
+    for(unsigned int in_flight = 4; in_flight <= INTERLEAVED_MAX; in_flight *= 2) {
+      st_conf.query_tasks = tasks;
+      st_conf.interleave = in_flight;
+      double query = time_queries(st, pos, m, out, repeats);
+      printf("%u,%u,%u,%u,%u,,%lf\n", best.workers, best.log_s,
+	     best.build_tasks, tasks, in_flight, query);
+      if(best_query < 0 || query < best_query) {
+	best_query = query;
+	best.query_tasks = tasks;
+	best.interleave = in_flight;
+      }
+    }
+  }
+  st_free(st);
+
+  if(st_config_save(profile, &best) != 0) {
+    fprintf(stderr, "Error: Cannot write the profile %s\n", profile);
+    exit(EXIT_FAILURE);
+  }
+  fprintf(stderr, "Profile %s: log_s=%u build_tasks=%u query_tasks=%u interleave=%u workers=%u\n",
+	  profile, best.log_s, best.build_tasks, best.query_tasks,
+	  best.interleave, best.workers);
+
+  free(pos);
+  free(out);
+  bit_array_free(S);
+
+  return EXIT_SUCCESS;
+}
@@ -113,6 +113,23 @@ void SetField(uint *A, register uint len, register uint index, register uint x)
   }
 }
 
+// Like SetField, but each word is updated with a CAS, so fields that share
+// a word can be written by different threads
+void SetFieldAtomic(uint *A, register uint len, register uint index, register uint x) {
+  uint i = index * len / W, j = index * len - i * W, old;
+  uint mask = ((j + len) < W ? ~0u << (j + len) : 0)
+      | ((W - j) < W ? ~0u >> (W - j) : 0);
+  old = __atomic_load_n(&A[i], __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&A[i], &old, (old & mask) | x << j, 1,
+				      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  if (j + len > W) {
+    mask = ((~0u) << (len + j - W));
+    old = __atomic_load_n(&A[i + 1], __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&A[i + 1], &old, (old & mask) | x >> (W - j), 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  }
+}
+
 uint GetVarField(uint *A, register uint ini, register uint fin) {
   register uint i = ini / W, j = ini - W * i, result;
   register uint len = (fin - ini + 1);
@@ -84,6 +84,7 @@ void bitwrite(uint *e, uint p, uint len, uint s);
 
 uint GetField(uint *A, register uint len, register uint index);
 void SetField(uint *A, register uint len, register uint index, register uint x);
+void SetFieldAtomic(uint *A, register uint len, register uint index, register uint x);
 
 uint GetVarField(uint *A, register uint ini, register uint fin);
 
@@ -0,0 +1,655 @@
+/******************************************************************************
+ * batch_queries.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <immintrin.h>
+
+#include "batch_queries.h"
+#include "binary_trees.h"
+#include "util.h"
+#include "basic.h"
+
+/* Offline matching of parentheses
+ *
+ * The range is split in blocks that are processed in parallel. Each block is
+ * swept with a stack, matching all the pairs that lie inside the block. The
+ * parentheses that remain unmatched inside a block (closing parentheses whose
+ * match is in a previous block and opening parentheses whose match is in a
+ * following block) are matched with a stack over the blocks, in order. Only
+ * the parentheses whose match is outside the range are resolved with the
+ * min-max tree (e', m' and M'), using find_open() and find_close(); there
+ * are at most depth-many of them.
+ */
+
+#define BULK_BLOCK_SIZE 65536 // Parentheses per block
+
+void st_match_range(rmMt* st, int32_t from, int32_t to, int32_t* M) {
+  if(to <= from)
+    return;
+
+  unsigned long len = to - from;
+  unsigned int num_blocks = (len + BULK_BLOCK_SIZE - 1)/BULK_BLOCK_SIZE;
+
+  // Unmatched parentheses of each block (ranges of 'pending')
+  int32_t* pending = (int32_t*)malloc(len*sizeof(int32_t));
+  unsigned int* num_closes = (unsigned int*)malloc(num_blocks*sizeof(unsigned int));
+  unsigned int* num_opens = (unsigned int*)malloc(num_blocks*sizeof(unsigned int));
+
+  /*
+   * STEP 1: Each block is swept with a stack
+   */
+  cilk_for(unsigned int block = 0; block < num_blocks; block++) {
+    int32_t llimit = from + block*BULK_BLOCK_SIZE;
+    int32_t ulimit = llimit + BULK_BLOCK_SIZE;
+    if(ulimit > to)
+      ulimit = to;
+
+    // The unmatched closing parentheses are stored at the beginning of the
+    // block range of 'pending' and the stack of opening parentheses at its end
+    int32_t* closes = pending + (llimit - from);
+    int32_t* stack = closes + (ulimit - llimit);
+    unsigned int c = 0, top = 0;
+
+    int32_t j = llimit;
+    while(j < ulimit) {
+      word_t w = st->bit_array->words[j>>logW] >> (j&(word_size-1));
+      int32_t wend = ((j>>logW)+1)<<logW;
+      if(wend > ulimit)
+	wend = ulimit;
+
+      for(; j < wend; j++, w >>= 1) {
+	if(w & 1)
+	  *--stack = j, top++;
+	else if(top) {
+	  int32_t open = *stack++;
+	  top--;
+	  M[open-from] = j;
+	  M[j-from] = open;
+	}
+	else
+	  closes[c++] = j;
+      }
+    }
+
+    // Unmatched opening parentheses are marked with -1 and moved next to the
+    // unmatched closing ones
+    for(unsigned int p = 0; p < top; p++)
+      M[stack[p]-from] = -1;
+    memmove(closes + c, stack, top*sizeof(int32_t));
+
+    num_closes[block] = c;
+    num_opens[block] = top;
+  }
+
+  /*
+   * STEP 2: Unmatched parentheses of the blocks are matched with a stack of
+   * opening parentheses. The closing parentheses of a block come before its
+   * opening ones, and 'opens' has the innermost opening parenthesis first
+   */
+  unsigned long total_opens = 0;
+  for(unsigned int block = 0; block < num_blocks; block++)
+    total_opens += num_opens[block];
+  int32_t* stack = (int32_t*)malloc((total_opens+1)*sizeof(int32_t));
+  unsigned long top = 0;
+
+  for(unsigned int block = 0; block < num_blocks; block++) {
+    int32_t* closes = pending + block*BULK_BLOCK_SIZE;
+    int32_t* opens = closes + num_closes[block];
+
+    for(unsigned int p = 0; p < num_closes[block]; p++) {
+      int32_t close = closes[p];
+      if(top == 0) { // Match before 'from'
+	M[close-from] = -1;
+	continue;
+      }
+      int32_t open = stack[--top];
+      M[close-from] = open;
+      M[open-from] = close;
+    }
+
+    for(unsigned int p = num_opens[block]; p > 0; p--)
+      stack[top++] = opens[p-1];
+  }
+
+  free(stack);
+
+  /*
+   * STEP 3: Parentheses matched outside [from, to) (still -1) are resolved
+   * using the min-max tree
+   */
+  cilk_for(unsigned int block = 0; block < num_blocks; block++) {
+    int32_t* closes = pending + block*BULK_BLOCK_SIZE;
+    int32_t* opens = closes + num_closes[block];
+
+    for(unsigned int p = 0; p < num_closes[block]; p++)
+      if(M[closes[p]-from] == -1)
+	M[closes[p]-from] = find_open(st, closes[p]);
+    for(unsigned int p = 0; p < num_opens[block]; p++)
+      if(M[opens[p]-from] == -1)
+	M[opens[p]-from] = find_close(st, opens[p]);
+  }
+
+  free(pending);
+  free(num_closes);
+  free(num_opens);
+}
+
+void st_match_all(rmMt* st, int32_t* M) {
+  st_match_range(st, 0, st->n, M);
+}
+
+void st_match_batch(rmMt* st, const int32_t* pos, unsigned long m, int32_t* out) {
+  if(m == 0)
+    return;
+
+  int32_t from = pos[0];
+  int32_t to = pos[m-1] + 1;
+
+  // Sparse batch: one tree walk per query
+  if(m*BULK_MATCH_DENSITY < (unsigned long)(to - from)) {
+    cilk_for(unsigned long q = 0; q < m; q++)
+      out[q] = match(st, pos[q]);
+    return;
+  }
+
+  // Dense batch: sweep the range spanned by the batch
+  int32_t* M = (int32_t*)malloc((to - from)*sizeof(int32_t));
+  st_match_range(st, from, to, M);
+
+  cilk_for(unsigned long q = 0; q < m; q++)
+    out[q] = M[pos[q]-from];
+
+  free(M);
+}
+
+/* Multi-query fwd_search
+ *
+ * Each group of SEARCH_LANES queries is answered in three steps:
+ * 1. The few bits before the first byte boundary after each position are
+ *    checked one by one (like check_leaf_r)
+ * 2. The rest of the chunk of each query is scanned, byte by byte, for all
+ *    the lanes at once
+ * 3. For the lanes that did not finish, the next chunk (the right sibling or
+ *    the chunk found by fwd_search_chunk) is scanned for all the lanes at once
+ */
+
+#define SEARCH_LANES 8
+
+// Lane q scans the bytes [j[q], end[q]), starting with excess ex[q], looking
+// for the excess value tg[q]. res[q] is the position where it is reached or -1.
+// The AVX2 kernel gathers the words and the table entries of all the lanes;
+// it is used when the CPU supports it (checked at run time)
+static int has_avx2() {
+  static int avx2 = -1;
+  if(avx2 < 0)
+    avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+
+__attribute__((target("avx2")))
+static void scan_lanes_avx2(rmMt* st, const int32_t* j, const int32_t* end,
+		       const int32_t* ex, const int32_t* tg, int32_t* res) {
+  const int* words = (const int*)st->bit_array->words;
+  const int* near_fwd_pos = (const int*)T->near_fwd_pos;
+  const int* word_sum = (const int*)T->word_sum;
+
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i c8 = _mm256_set1_epi32(8);
+  const __m256i c31 = _mm256_set1_epi32(31);
+  const __m256i cFF = _mm256_set1_epi32(0xFF);
+  const __m256i cm9 = _mm256_set1_epi32(-9);
+
+  __m256i vj = _mm256_loadu_si256((const __m256i*)j);
+  __m256i vend = _mm256_loadu_si256((const __m256i*)end);
+  __m256i vex = _mm256_loadu_si256((const __m256i*)ex);
+  __m256i vtg = _mm256_loadu_si256((const __m256i*)tg);
+  __m256i vres = _mm256_set1_epi32(-1);
+  __m256i active = _mm256_cmpgt_epi32(vend, vj); // Mask of unfinished lanes
+
+  while(!_mm256_testz_si256(active, active)) {
+    // 8-bit word at position j of each lane
+    __m256i w = _mm256_mask_i32gather_epi32(zero, words, _mm256_srli_epi32(vj, logW),
+					    active, 4);
+    __m256i vw = _mm256_and_si256(_mm256_srlv_epi32(w, _mm256_and_si256(vj, c31)), cFF);
+
+    // desired value must belongs to the range [-8,8]
+    __m256i desired = _mm256_sub_epi32(vtg, vex);
+    __m256i in_table = _mm256_and_si256(_mm256_cmpgt_epi32(desired, cm9),
+					_mm256_cmpgt_epi32(c8, desired));
+    __m256i idx = _mm256_or_si256(_mm256_slli_epi32(_mm256_add_epi32(desired, c8), 8), vw);
+    __m256i p = _mm256_mask_i32gather_epi32(c8, near_fwd_pos, idx,
+					    _mm256_and_si256(active, in_table), 1);
+    p = _mm256_and_si256(p, cFF);
+
+    // desired == 8 is only reached at the last bit of the word 11111111
+    __m256i all_ones = _mm256_and_si256(_mm256_cmpeq_epi32(desired, c8),
+					_mm256_cmpeq_epi32(vw, cFF));
+    p = _mm256_blendv_epi8(p, _mm256_set1_epi32(7), all_ones);
+
+    __m256i hit = _mm256_and_si256(active, _mm256_cmpgt_epi32(c8, p));
+    vres = _mm256_blendv_epi8(vres, _mm256_add_epi32(vj, p), hit);
+    active = _mm256_andnot_si256(hit, active);
+
+    // Excess at the end of the word
+    __m256i ws = _mm256_mask_i32gather_epi32(zero, word_sum, vw, active, 1);
+    ws = _mm256_srai_epi32(_mm256_slli_epi32(ws, 24), 24);
+    vex = _mm256_add_epi32(vex, ws);
+
+    vj = _mm256_add_epi32(vj, c8);
+    active = _mm256_and_si256(active, _mm256_cmpgt_epi32(vend, vj));
+  }
+
+  _mm256_storeu_si256((__m256i*)res, vres);
+}
+
+static void scan_lanes_scalar(rmMt* st, const int32_t* j, const int32_t* end,
+		       const int32_t* ex, const int32_t* tg, int32_t* res) {
+  for(int q = 0; q < SEARCH_LANES; q++) {
+    int32_t excess = ex[q];
+    res[q] = -1;
+
+    for(int32_t k = j[q]; k < end[q]; k += 8) {
+      int32_t desired = tg[q] - excess; // desired value must belongs to the range [-8,8]
+      int32_t sum_idx = (((st->bit_array)->words[k>>logW]) & (0xFF<<(k&(word_size-1)))) >> (k&(word_size-1));
+
+      if(desired >= -8 && desired < 8) {
+	int8_t x = T->near_fwd_pos[(desired+8<<8) + sum_idx];
+	if(x < 8) {
+	  res[q] = k+x;
+	  break;
+	}
+      }
+      else if(desired == 8 && sum_idx == 0xFF) {
+	res[q] = k+7;
+	break;
+      }
+      excess += T->word_sum[sum_idx];
+    }
+  }
+}
+
+// The bits after st->n (zero padding of the last word) are not part of the
+// sequence, so a position found there means not found
+static void scan_lanes(rmMt* st, const int32_t* j, const int32_t* end,
+		       const int32_t* ex, const int32_t* tg, int32_t* res) {
+  if(has_avx2())
+    scan_lanes_avx2(st, j, end, ex, tg, res);
+  else
+    scan_lanes_scalar(st, j, end, ex, tg, res);
+
+  for(int q = 0; q < SEARCH_LANES; q++)
+    if(res[q] >= (int32_t)st->n)
+      res[q] = -1;
+}
+
+// Answers up to SEARCH_LANES queries
+static void fwd_search_lanes(rmMt* st, const int32_t* pos, const int32_t* d,
+			     int lanes, int32_t* out) {
+  int32_t j[SEARCH_LANES], end[SEARCH_LANES], ex[SEARCH_LANES];
+  int32_t tg[SEARCH_LANES], res[SEARCH_LANES];
+  int32_t chunk[SEARCH_LANES];
+  char sibling[SEARCH_LANES], done[SEARCH_LANES];
+
+  /*
+   * STEP 1: Bits up to the first byte boundary
+   */
+  for(int q = 0; q < SEARCH_LANES; q++) {
+    j[q] = end[q] = ex[q] = tg[q] = 0;
+    done[q] = 1;
+    if(q >= lanes)
+      continue;
+
+    int32_t i = pos[q];
+    int32_t excess = sum(st, i);
+    tg[q] = excess + d[q] - 1;
+    chunk[q] = i >> st->log_s;
+    done[q] = 0;
+
+    int32_t cend = (chunk[q]+1)*st->s;
+    int32_t llimit = ((i+8)/8)*8;
+    int32_t k;
+
+    // The last chunk may be incomplete
+    if(cend > st->n)
+      cend = st->n;
+
+    for(k = i+1; k < min(min(cend, llimit), st->n); k++) {
+      excess += 2*bit_array_get_bit(st->bit_array,k)-1;
+      if(excess == tg[q]) {
+	out[q] = k;
+	done[q] = 1;
+	break;
+      }
+    }
+
+    j[q] = llimit;
+    end[q] = done[q] ? llimit : cend;
+    ex[q] = excess;
+  }
+
+  /*
+   * STEP 2: The rest of the chunk of each query
+   */
+  scan_lanes(st, j, end, ex, tg, res);
+
+  for(int q = 0; q < lanes; q++) {
+    int32_t c = chunk[q];
+    j[q] = end[q] = 0;
+    if(done[q])
+      continue;
+
+    if(res[q] >= 0) {
+      out[q] = res[q];
+      done[q] = 1;
+      continue;
+    }
+
+    // Case 2 of fwd_search: the right sibling of the chunk
+    sibling[q] = (c%2 == 0) && c+1 < (int32_t)st->num_chunks &&
+      st->m_prime[st->internal_nodes + c+1] <= tg[q] &&
+      tg[q] <= st->M_prime[st->internal_nodes + c+1];
+
+    // Case 3 of fwd_search: the chunk found in the min-max tree
+    if(!sibling[q]) {
+      c = fwd_search_chunk(st, c, tg[q]);
+      if(c < 0) {
+	out[q] = pos[q];
+	done[q] = 1;
+	continue;
+      }
+    }
+    else
+      c++;
+
+    j[q] = st->s*c;
+    end[q] = min(j[q] + st->s, (int32_t)st->n);
+    ex[q] = st->e_prime[c-1];
+  }
+
+  /*
+   * STEP 3: The next chunk of each unfinished query
+   */
+  scan_lanes(st, j, end, ex, tg, res);
+
+  for(int q = 0; q < lanes; q++) {
+    if(done[q])
+      continue;
+
+    if(res[q] >= 0)
+      out[q] = res[q];
+    else if(sibling[q]) // The answer is not in the sibling (rare)
+      out[q] = fwd_search(st, pos[q], d[q]);
+    else
+      out[q] = j[q]-1; // Not found (it mimics check_sibling_r)
+  }
+}
+
+void fwd_search_batch(rmMt* st, const int32_t* pos, const int32_t* d,
+		      unsigned long m, int32_t* out) {
+  unsigned long num_groups = (m + SEARCH_LANES - 1)/SEARCH_LANES;
+
+  cilk_for(unsigned long group = 0; group < num_groups; group++) {
+    unsigned long first = group*SEARCH_LANES;
+    int lanes = (m - first < SEARCH_LANES) ? m - first : SEARCH_LANES;
+
+    fwd_search_lanes(st, pos + first, d + first, lanes, out + first);
+  }
+}
+
+void find_close_batch(rmMt* st, const int32_t* pos, unsigned long m, int32_t* out) {
+  unsigned long num_groups = (m + SEARCH_LANES - 1)/SEARCH_LANES;
+  const int32_t zeros[SEARCH_LANES] = {0};
+
+  cilk_for(unsigned long group = 0; group < num_groups; group++) {
+    unsigned long first = group*SEARCH_LANES;
+    int lanes = (m - first < SEARCH_LANES) ? m - first : SEARCH_LANES;
+    int32_t opens[SEARCH_LANES], res[SEARCH_LANES];
+    int num_opens = 0;
+
+    // Closing parentheses are their own answer
+    for(int q = 0; q < lanes; q++) {
+      if(bit_array_get_bit(st->bit_array, pos[first+q]))
+	opens[num_opens++] = pos[first+q];
+      else
+	out[first+q] = pos[first+q];
+    }
+
+    fwd_search_lanes(st, opens, zeros, num_opens, res);
+
+    for(int q = 0, o = 0; q < lanes; q++)
+      if(bit_array_get_bit(st->bit_array, pos[first+q]))
+	out[first+q] = res[o++];
+  }
+}
+
+/* Interleaved find_close
+ *
+ * Each query follows the steps of fwd_search (with d = 0), split at every
+ * dependent memory access: before moving to the next step it prefetches
+ * the data of that step and yields. Queries are resumed round-robin.
+ */
+
+enum query_step {
+  Q_START,       // Prefetch the word of i and e' of the previous chunk
+  Q_LEAF,        // Case 1: the chunk of i
+  Q_SIBLING,     // Case 2: check m' and M' of the right sibling
+  Q_SIBLING_SCAN,// Case 2: scan the right sibling
+  Q_UP,          // Case 3: go up the min-max tree
+  Q_UP_CHECK,    // Case 3: check m' and M' of the right sibling of a node
+  Q_DOWN,        // Case 3: go down the min-max tree
+  Q_FINAL        // Case 3: scan the chunk found in the min-max tree
+};
+
+struct query_state {
+  enum query_step step;
+  int32_t i;      // Position of the query
+  int32_t target; // Excess value that is being searched
+  int32_t chunk;
+  long node;      // Current node of the min-max tree
+  int32_t* out;
+};
+
+#define contains(st, node, target) \
+  ((st)->m_prime[node] <= (target) && (target) <= (st)->M_prime[node])
+
+static inline void prefetch_chunk(rmMt* st, int32_t chunk) {
+  __builtin_prefetch(&st->bit_array->words[(chunk*st->s)>>logW]);
+  if(chunk)
+    __builtin_prefetch(&st->e_prime[chunk-1]);
+}
+
+static inline void prefetch_node(rmMt* st, long node) {
+  __builtin_prefetch(&st->m_prime[node]);
+  __builtin_prefetch(&st->M_prime[node]);
+}
+
+// It runs a query until its next memory access. It returns 1 if the query
+// has finished
+static int resume_query(rmMt* st, struct query_state* q) {
+  int32_t output;
+
+  for(;;) {
+    switch(q->step) {
+    case Q_START:
+      q->chunk = q->i >> st->log_s;
+      __builtin_prefetch(&st->bit_array->words[q->i>>logW]);
+      if(q->chunk)
+	__builtin_prefetch(&st->e_prime[q->chunk-1]);
+      q->step = Q_LEAF;
+      return 0;
+
+    case Q_LEAF:
+      if(bit_array_get_bit(st->bit_array, q->i) == 0) {
+	*q->out = q->i;
+	return 1;
+      }
+
+      q->target = sum(st, q->i) - 1;
+      output = check_leaf_r(st, q->i, q->target, q->target+1);
+      if(output > q->i) {
+	*q->out = output;
+	return 1;
+      }
+
+      if(q->chunk%2 == 0 && q->chunk+1 < st->num_chunks) {
+	prefetch_node(st, st->internal_nodes + q->chunk+1);
+	q->step = Q_SIBLING;
+	return 0;
+      }
+      q->node = parent(q->chunk + st->internal_nodes);
+      q->step = Q_UP;
+      break;
+
+    case Q_SIBLING:
+      if(contains(st, st->internal_nodes + q->chunk+1, q->target)) {
+	prefetch_chunk(st, q->chunk+1);
+	q->step = Q_SIBLING_SCAN;
+	return 0;
+      }
+      q->node = parent(q->chunk + st->internal_nodes);
+      q->step = Q_UP;
+      break;
+
+    case Q_SIBLING_SCAN:
+      output = check_sibling_r(st, st->s*(q->chunk+1), q->target);
+      if(output >= st->s*(q->chunk+1)) {
+	*q->out = output;
+	return 1;
+      }
+      q->node = parent(q->chunk + st->internal_nodes);
+      q->step = Q_UP;
+      break;
+
+    case Q_UP:
+      if(is_root(q->node)) { // Not found
+	*q->out = q->i;
+	return 1;
+      }
+      if(is_left_child(q->node)) {
+	q->node = right_sibling(q->node);
+	ensure_node(st, q->node);
+	prefetch_node(st, q->node);
+	q->step = Q_UP_CHECK;
+	return 0;
+      }
+      q->node = parent(q->node);
+      break;
+
+    case Q_UP_CHECK:
+      if(contains(st, q->node, q->target)) {
+	prefetch_node(st, left_child(q->node));
+	q->step = Q_DOWN;
+	return 0;
+      }
+      q->node = parent(q->node);
+      q->step = Q_UP;
+      break;
+
+    case Q_DOWN:
+      if(is_leaf(q->node, st)) {
+	q->chunk = q->node - st->internal_nodes;
+	prefetch_chunk(st, q->chunk);
+	q->step = Q_FINAL;
+	return 0;
+      }
+      q->node = left_child(q->node);
+      if(!contains(st, q->node, q->target)) {
+	q->node = right_sibling(q->node);
+	if(!contains(st, q->node, q->target)) {
+	  *q->out = q->i;
+	  return 1;
+	}
+      }
+      prefetch_node(st, left_child(q->node));
+      return 0;
+
+    case Q_FINAL:
+      *q->out = check_sibling_r(st, st->s*q->chunk, q->target);
+      return 1;
+    }
+  }
+}
+
+static void find_close_interleaved(rmMt* st, const int32_t* pos, unsigned long m,
+				   int32_t* out, int in_flight) {
+  struct query_state q[INTERLEAVED_MAX];
+  int active[INTERLEAVED_MAX];
+  unsigned long next = 0;
+  int num_active = 0;
+
+  for(int k = 0; k < in_flight; k++) {
+    active[k] = next < m;
+    if(active[k]) {
+      q[k].step = Q_START;
+      q[k].i = pos[next];
+      q[k].out = &out[next];
+      next++;
+      num_active++;
+    }
+  }
+
+  // Round-robin over the queries in flight. A finished query is replaced by
+  // the next query of the batch
+  while(num_active) {
+    for(int k = 0; k < in_flight; k++) {
+      if(!active[k] || !resume_query(st, &q[k]))
+	continue;
+
+      if(next < m) {
+	q[k].step = Q_START;
+	q[k].i = pos[next];
+	q[k].out = &out[next];
+	next++;
+      }
+      else {
+	active[k] = 0;
+	num_active--;
+      }
+    }
+  }
+}
+
+void find_close_batch_interleaved(rmMt* st, const int32_t* pos, unsigned long m,
+				  int32_t* out) {
+  // Each part of the batch is a contiguous range of queries, interleaved by
+  // a single worker
+  unsigned int parts = threads*st_conf.query_tasks;
+  unsigned long per_part = (m + parts - 1)/parts;
+  int in_flight = st_conf.interleave ? min(st_conf.interleave, INTERLEAVED_MAX)
+    : INTERLEAVED_QUERIES;
+
+  cilk_for(unsigned int part = 0; part < parts; part++) {
+    unsigned long first = part*per_part;
+    if(first < m) {
+      unsigned long len = (m - first < per_part) ? m - first : per_part;
+      find_close_interleaved(st, pos + first, len, out + first, in_flight);
+    }
+  }
+}
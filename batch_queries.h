@@ -0,0 +1,77 @@
+/******************************************************************************
+ * batch_queries.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef BATCH_QUERIES_H
+#define BATCH_QUERIES_H
+
+#include "succinct_tree.h"
+
+// Offline matching: when a batch covers a large fraction of the parentheses
+// of a range, a stack sweep over the range is much faster than a tree walk
+// per query. The batch is answered with the sweep when it has at least one
+// query every BULK_MATCH_DENSITY parentheses of the range it spans
+#define BULK_MATCH_DENSITY 64
+
+// It computes the explicit match array of the whole sequence:
+// M[i] = match(st, i) for i in [0, n). M must have room for st->n elements
+void st_match_all(rmMt* st, int32_t* M);
+
+// It computes M[j] = match(st, from+j) for j in [0, to-from)
+void st_match_range(rmMt* st, int32_t from, int32_t to, int32_t* M);
+
+// It answers out[j] = match(st, pos[j]) for a batch of m positions sorted in
+// increasing order
+void st_match_batch(rmMt* st, const int32_t* pos, unsigned long m, int32_t* out);
+
+// Multi-query search: the in-chunk scans of independent queries are advanced
+// in lockstep, SEARCH_LANES queries at a time (with AVX2 gathers into the
+// bit array and the lookup tables when available). Queries are independent,
+// so 'pos' does not need to be sorted.
+
+// out[q] = fwd_search(st, pos[q], d[q])
+void fwd_search_batch(rmMt* st, const int32_t* pos, const int32_t* d,
+		      unsigned long m, int32_t* out);
+
+// out[q] = find_close(st, pos[q])
+void find_close_batch(rmMt* st, const int32_t* pos, unsigned long m, int32_t* out);
+
+// Interleaved find_close: each part of the batch (st_conf.query_tasks per
+// worker) keeps st_conf.interleave queries in flight as resumable state
+// machines. A query issues a prefetch for the next memory location it needs
+// (bit array word, leaf summary, sibling, parent...) and yields, so the cache
+// misses of different queries overlap. It pays off when the tree is not in
+// cache (see the '_cold' methods of query_bench.c); on trees that are already
+// cached plain find_close is faster
+#define INTERLEAVED_QUERIES 16 // Default queries in flight
+#define INTERLEAVED_MAX 64
+
+// out[q] = find_close(st, pos[q])
+void find_close_batch_interleaved(rmMt* st, const int32_t* pos, unsigned long m,
+				  int32_t* out);
+
+#endif // BATCH_QUERIES_H
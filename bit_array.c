@@ -39,7 +39,11 @@
 #include <string.h> // memset
 #include <math.h> // memset
 
+#include <stdint.h>
+#include <immintrin.h>
+
 #include "bit_array.h"
+#include "defs.h"
 
 #define MIN(a, b)  (((a) <= (b)) ? (a) : (b))
 #define MAX(a, b)  (((a) >= (b)) ? (a) : (b))
@@ -269,6 +273,118 @@ BIT_ARRAY* bit_array_clone(BIT_ARRAY* bitarr) {
   return cpy;
 }
 
+BIT_ARRAY* bit_array_extract(BIT_ARRAY* bitarr, bit_index_t from, bit_index_t len) {
+  BIT_ARRAY* cpy = bit_array_create(len);
+  parallel_bit_array_copy_range(cpy, 0, bitarr, from, len);
+  return cpy;
+}
+
+//
+// Range copies on 64-bit words. Bit i of a bit array is bit i%64 of its
+// 64-bit word i/64 (two consecutive words, little endian). The number of
+// 32-bit words may be odd, so the last 64-bit word is accessed by halves
+//
+
+#define COPY_GRAIN 4096 // 64-bit words of the destination per parallel task
+
+static inline uint64_t get64(const word_t* w, word_addr_t nw, uint64_t i) {
+  uint64_t v;
+  if(2*i + 1 < nw) {
+    memcpy(&v, w + 2*i, sizeof(v));
+    return v;
+  }
+  return 2*i < nw ? w[2*i] : 0;
+}
+
+static inline void put64(word_t* w, word_addr_t nw, uint64_t i, uint64_t v) {
+  if(2*i + 1 < nw)
+    memcpy(w + 2*i, &v, sizeof(v));
+  else if(2*i < nw)
+    w[2*i] = (word_t)v;
+}
+
+// 64 bits of w starting at bit q
+static inline uint64_t bits64(const word_t* w, word_addr_t nw, uint64_t q) {
+  unsigned int sh = q % 64;
+  uint64_t v = get64(w, nw, q / 64) >> sh;
+  if(sh)
+    v |= get64(w, nw, q / 64 + 1) << (64 - sh);
+  return v;
+}
+
+// It copies the bits of [dst_off, dst_off+len) that are in the 64-bit
+// words [lo, hi) of dest. Words are visited downwards if backward
+static void copy_words(BIT_ARRAY* dest, uint64_t dst_off, BIT_ARRAY* src,
+                       uint64_t src_off, uint64_t len, uint64_t lo,
+                       uint64_t hi, int backward) {
+  word_addr_t dn = nwords(dest->num_of_bits), sn = nwords(src->num_of_bits);
+  uint64_t end = dst_off + len;
+  uint64_t k;
+
+  for(k = 0; k < hi - lo; k++) {
+    uint64_t i = backward ? hi - 1 - k : lo + k;
+    uint64_t first = MAX(i * 64, dst_off), last = MIN(i * 64 + 64, end);
+    uint64_t v = bits64(src->words, sn, first - dst_off + src_off);
+
+    if(first == i * 64 && last == i * 64 + 64)
+      put64(dest->words, dn, i, v);
+    else { // Partial word
+      unsigned int sh = first % 64, n = last - first;
+      uint64_t mask = (n == 64 ? ~0UL : ((1UL << n) - 1)) << sh;
+      uint64_t old = get64(dest->words, dn, i);
+      put64(dest->words, dn, i, (old & ~mask) | ((v << sh) & mask));
+    }
+  }
+}
+
+void bit_array_copy_range(BIT_ARRAY* dest, bit_index_t dst_off,
+                          BIT_ARRAY* src, bit_index_t src_off, bit_index_t len) {
+  if(len == 0)
+    return;
+
+  // Like memmove, overlapping copies to the right go backwards
+  int backward = dest == src && dst_off > src_off;
+
+  // Word-aligned offsets: whole words are moved, and the partial last word
+  // is copied before them if the copy goes backwards
+  if(boffset(dst_off) == 0 && boffset(src_off) == 0) {
+    word_addr_t full = len / WORD_SIZE;
+    uint64_t rest = full * WORD_SIZE;
+    if(backward && rest < len)
+      copy_words(dest, dst_off + rest, src, src_off + rest, len - rest,
+                 ((uint64_t)dst_off + rest) / 64, ((uint64_t)dst_off + len + 63) / 64, 1);
+    memmove(dest->words + bindex(dst_off), src->words + bindex(src_off),
+            full * sizeof(word_t));
+    if(!backward && rest < len)
+      copy_words(dest, dst_off + rest, src, src_off + rest, len - rest,
+                 ((uint64_t)dst_off + rest) / 64, ((uint64_t)dst_off + len + 63) / 64, 0);
+    return;
+  }
+
+  copy_words(dest, dst_off, src, src_off, len, (uint64_t)dst_off / 64,
+             ((uint64_t)dst_off + len + 63) / 64, backward);
+}
+
+void parallel_bit_array_copy_range(BIT_ARRAY* dest, bit_index_t dst_off,
+                                   BIT_ARRAY* src, bit_index_t src_off,
+                                   bit_index_t len) {
+  uint64_t lo = (uint64_t)dst_off / 64, hi = ((uint64_t)dst_off + len + 63) / 64;
+
+  // Overlapping copies keep their order
+  if(len == 0 || hi - lo <= COPY_GRAIN ||
+     (dest == src && dst_off < src_off + len && src_off < dst_off + len)) {
+    bit_array_copy_range(dest, dst_off, src, src_off, len);
+    return;
+  }
+
+  // Each task owns its 64-bit words of dest, so no word is shared
+  uint64_t num_tasks = (hi - lo + COPY_GRAIN - 1) / COPY_GRAIN;
+  cilk_for(uint64_t t = 0; t < num_tasks; t++) {
+    uint64_t l = lo + t * COPY_GRAIN;
+    copy_words(dest, dst_off, src, src_off, len, l, MIN(l + COPY_GRAIN, hi), 0);
+  }
+}
+
 /*
 void bit_array_copy(BIT_ARRAY* dest, bit_index_t dstindx,
                     BIT_ARRAY* src, bit_index_t srcindx, bit_index_t length)
@@ -319,19 +435,146 @@ char bit_array_resize(BIT_ARRAY* bitarr, bit_index_t new_num_of_bits) {
   return 1;
 }
 
+//
+// Bulk word kernels: AVX2 when the CPU supports it (checked at run time),
+// and cilk_for over blocks of BULK_GRAIN words for arrays of at least
+// BULK_THRESHOLD words
+//
+
+#define BULK_THRESHOLD (1 << 16)
+#define BULK_GRAIN (1 << 14)
+
+enum bulk_op { BULK_AND, BULK_OR, BULK_XOR, BULK_NOT };
+
+static int has_avx2() {
+  static int avx2 = -1;
+  if(avx2 < 0)
+    avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+
+static void bulk_scalar(enum bulk_op op, word_t* d, const word_t* a,
+                        const word_t* b, word_addr_t n) {
+  word_addr_t i;
+  switch(op) {
+  case BULK_AND: for(i = 0; i < n; i++) d[i] = a[i] & b[i]; break;
+  case BULK_OR:  for(i = 0; i < n; i++) d[i] = a[i] | b[i]; break;
+  case BULK_XOR: for(i = 0; i < n; i++) d[i] = a[i] ^ b[i]; break;
+  case BULK_NOT: for(i = 0; i < n; i++) d[i] = ~a[i]; break;
+  }
+}
+
+#define AVX2_WORDS (32 / sizeof(word_t))
+
+__attribute__((target("avx2")))
+static void bulk_avx2(enum bulk_op op, word_t* d, const word_t* a,
+                      const word_t* b, word_addr_t n) {
+  word_addr_t i, vn = n - n % AVX2_WORDS;
+  __m256i ones = _mm256_set1_epi32(-1);
+
+  for(i = 0; i < vn; i += AVX2_WORDS) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + i)), r;
+    switch(op) {
+    case BULK_AND: r = _mm256_and_si256(x, _mm256_loadu_si256((const __m256i*)(b + i))); break;
+    case BULK_OR:  r = _mm256_or_si256(x, _mm256_loadu_si256((const __m256i*)(b + i))); break;
+    case BULK_XOR: r = _mm256_xor_si256(x, _mm256_loadu_si256((const __m256i*)(b + i))); break;
+    default:       r = _mm256_xor_si256(x, ones); break;
+    }
+    _mm256_storeu_si256((__m256i*)(d + i), r);
+  }
+
+  bulk_scalar(op, d + vn, a + vn, b ? b + vn : NULL, n - vn);
+}
+
+static void bulk_range(enum bulk_op op, word_t* d, const word_t* a,
+                       const word_t* b, word_addr_t n) {
+  if(has_avx2())
+    bulk_avx2(op, d, a, b, n);
+  else
+    bulk_scalar(op, d, a, b, n);
+}
+
+static void bulk(enum bulk_op op, word_t* d, const word_t* a, const word_t* b,
+                 word_addr_t n) {
+  if(n < BULK_THRESHOLD) {
+    bulk_range(op, d, a, b, n);
+    return;
+  }
+
+  word_addr_t num_blocks = (n + BULK_GRAIN - 1) / BULK_GRAIN;
+  cilk_for(word_addr_t k = 0; k < num_blocks; k++) {
+    word_addr_t lo = k * BULK_GRAIN, len = MIN(BULK_GRAIN, n - lo);
+    bulk_range(op, d + lo, a + lo, b ? b + lo : NULL, len);
+  }
+}
+
+// Number of ones of a[i] & b[i], stored in d if it is not NULL
+static unsigned long and_count_scalar(word_t* d, const word_t* a,
+                                      const word_t* b, word_addr_t n) {
+  unsigned long count = 0;
+  word_addr_t i;
+  for(i = 0; i < n; i++) {
+    word_t w = a[i] & b[i];
+    if(d)
+      d[i] = w;
+    count += __builtin_popcount(w);
+  }
+  return count;
+}
+
+// Popcount of 256-bit vectors with a nibble table (vpshufb), summed by bytes
+__attribute__((target("avx2")))
+static unsigned long and_count_avx2(word_t* d, const word_t* a,
+                                    const word_t* b, word_addr_t n) {
+  const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+  word_addr_t i, vn = n - n % AVX2_WORDS;
+
+  for(i = 0; i < vn; i += AVX2_WORDS) {
+    __m256i w = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                 _mm256_loadu_si256((const __m256i*)(b + i)));
+    if(d)
+      _mm256_storeu_si256((__m256i*)(d + i), w);
+    __m256i c = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(w, low)),
+                                _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(w, 4), low)));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+  }
+
+  unsigned long count = _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) +
+    _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+
+  return count + and_count_scalar(d ? d + vn : NULL, a + vn, b + vn, n - vn);
+}
+
+static unsigned long and_count_range(word_t* d, const word_t* a,
+                                     const word_t* b, word_addr_t n) {
+  return has_avx2() ? and_count_avx2(d, a, b, n) : and_count_scalar(d, a, b, n);
+}
+
+// Highest index in [0, n) where a and b differ, or -1
+static long highest_diff_range(const word_t* a, const word_t* b, word_addr_t n) {
+  word_addr_t i = n;
+  while(i > 0) {
+    i--;
+    if(a[i] != b[i])
+      return i;
+  }
+  return -1;
+}
+
 //
 // Logic operators
 //
 
+
 void bit_array_and(BIT_ARRAY* dest, BIT_ARRAY* src1, BIT_ARRAY* src2) {
   if(dest->num_of_bits == src1->num_of_bits &&
       src1->num_of_bits == src2->num_of_bits) {
     word_addr_t num_of_words = nwords(src1->num_of_bits);
 
-    word_addr_t i;
-    for(i = 0; i < num_of_words; i++) {
-      dest->words[i] = src1->words[i] & src2->words[i];
-    }
+    bulk(BULK_AND, dest->words, src1->words, src2->words, num_of_words);
   } else {
     // error
     fprintf(stderr, "bit_array.c: bit_array_and() : "
@@ -347,10 +590,7 @@ void bit_array_or(BIT_ARRAY* dest, BIT_ARRAY* src1, BIT_ARRAY* src2) {
       src1->num_of_bits == src2->num_of_bits) {
     word_addr_t num_of_words = nwords(src1->num_of_bits);
 
-    word_addr_t i;
-    for(i = 0; i < num_of_words; i++) {
-      dest->words[i] = src1->words[i] | src2->words[i];
-    }
+    bulk(BULK_OR, dest->words, src1->words, src2->words, num_of_words);
 
   } else {
     // error
@@ -367,10 +607,7 @@ void bit_array_xor(BIT_ARRAY* dest, BIT_ARRAY* src1, BIT_ARRAY* src2) {
       src1->num_of_bits == src2->num_of_bits) {
     word_addr_t num_of_words = nwords(src1->num_of_bits);
 
-    word_addr_t i;
-    for(i = 0; i < num_of_words; i++) {
-      dest->words[i] = src1->words[i] ^ src2->words[i];
-    }
+    bulk(BULK_XOR, dest->words, src1->words, src2->words, num_of_words);
   } else {
     // error
     fprintf(stderr, "bit_array.c: bit_array_and() : "
@@ -391,10 +628,53 @@ void bit_array_not(BIT_ARRAY* dest, BIT_ARRAY* src) {
 
   word_addr_t num_of_words = nwords(dest->num_of_bits);
 
-  word_addr_t i;
-  for(i = 0; i < num_of_words; i++) {
-    dest->words[i] = ~(src->words[i]);
+  bulk(BULK_NOT, dest->words, src->words, NULL, num_of_words);
+
+  // Bits past the end stay zero
+  if(boffset(dest->num_of_bits) > 0)
+    dest->words[num_of_words - 1] &= BIT_MASK(boffset(dest->num_of_bits));
+}
+
+unsigned long bit_array_and_count(BIT_ARRAY* dest, BIT_ARRAY* src1, BIT_ARRAY* src2) {
+  if(src1->num_of_bits != src2->num_of_bits ||
+     (dest && dest->num_of_bits != src1->num_of_bits)) {
+    // error
+    fprintf(stderr, "bit_array.c: bit_array_and_count() : "
+            "dest, src1 and src2 must be of the same length\n");
+    exit(EXIT_FAILURE);
+  }
+
+  word_addr_t num_of_words = nwords(src1->num_of_bits);
+  if(num_of_words == 0)
+    return 0;
+
+  // The last word is masked, so the full words are counted in bulk
+  word_addr_t full = num_of_words - 1;
+  word_t* d = dest ? dest->words : NULL;
+  unsigned long count = 0;
+
+  if(full < BULK_THRESHOLD)
+    count = and_count_range(d, src1->words, src2->words, full);
+  else {
+    word_addr_t num_blocks = (full + BULK_GRAIN - 1) / BULK_GRAIN;
+    unsigned long* counts = (unsigned long*) malloc(num_blocks * sizeof(unsigned long));
+    cilk_for(word_addr_t k = 0; k < num_blocks; k++) {
+      word_addr_t lo = k * BULK_GRAIN, len = MIN(BULK_GRAIN, full - lo);
+      counts[k] = and_count_range(d ? d + lo : NULL, src1->words + lo, src2->words + lo, len);
+    }
+    word_addr_t k;
+    for(k = 0; k < num_blocks; k++)
+      count += counts[k];
+    free(counts);
   }
+
+  word_t last = src1->words[full] & src2->words[full];
+  if(boffset(src1->num_of_bits) > 0)
+    last &= BIT_MASK(boffset(src1->num_of_bits));
+  if(d)
+    d[full] = last;
+
+  return count + __builtin_popcount(last);
 }
 
 
@@ -422,11 +702,16 @@ int bit_array_compare(BIT_ARRAY* bitarr1, BIT_ARRAY* bitarr2) {
   word_addr_t nwords2 = nwords(bitarr2->num_of_bits);
 
   word_addr_t max_words = MAX(nwords1, nwords2);
+  word_addr_t min_words = MIN(nwords1, nwords2);
 
-  word_addr_t i;
+  // Words below the last word of the shorter array need no masking
+  word_addr_t common = min_words > 0 ? min_words - 1 : 0;
+
+  word_addr_t i = max_words;
   word_t word1, word2;
 
-  for(i = max_words - 1; i >= 0; i--) {
+  while(i > common) {
+    i--;
     word1 = get_word(bitarr1, i, nwords1);
     word2 = get_word(bitarr2, i, nwords2);
 
@@ -437,7 +722,27 @@ int bit_array_compare(BIT_ARRAY* bitarr1, BIT_ARRAY* bitarr2) {
     }
   }
 
-  return 0;
+  long diff = -1;
+  if(common < BULK_THRESHOLD)
+    diff = highest_diff_range(bitarr1->words, bitarr2->words, common);
+  else {
+    word_addr_t num_blocks = (common + BULK_GRAIN - 1) / BULK_GRAIN;
+    long* diffs = (long*) malloc(num_blocks * sizeof(long));
+    cilk_for(word_addr_t k = 0; k < num_blocks; k++) {
+      word_addr_t lo = k * BULK_GRAIN, len = MIN(BULK_GRAIN, common - lo);
+      long d = highest_diff_range(bitarr1->words + lo, bitarr2->words + lo, len);
+      diffs[k] = d < 0 ? -1 : (long)lo + d;
+    }
+    word_addr_t k = num_blocks;
+    while(k > 0 && diff < 0)
+      diff = diffs[--k];
+    free(diffs);
+  }
+
+  if(diff < 0)
+    return 0;
+
+  return bitarr1->words[diff] > bitarr2->words[diff] ? 1 : -1;
 }
 
 // Return 0 if there was an overflow error, 1 otherwise
@@ -731,320 +1036,12 @@ void bit_array_concat(BIT_ARRAY* dest, BIT_ARRAY* from) {
   *d++ |= (*f << desp);
 }
 
+// Wrappers of bit_array_copy_range (the bits of dest in the range are
+// replaced instead of OR-ed)
 void bit_array_concat_from(BIT_ARRAY* dest, BIT_ARRAY* source, int from, int lvl, int node, int thread) {
-
- if(source->num_of_bits > 0)
- {
-//if(lvl==0)
-//	printf("\"%p\" (%d),\"%p\"(%d),%d\n", dest, dest->num_of_bits, source, source->num_of_bits, from);
-
-  unsigned int count, corr, desp;
-  unsigned int nwords_old, nwords_new;
-  unsigned int newsize;
-
-  word_t* d;
-  word_t* f;
-
-  desp = from % WORD_SIZE;
-  corr = WORD_SIZE - desp;
-
-  int new_size = from + source->num_of_bits;
-  nwords_old = nwords(from + 1);
-  nwords_new = nwords(new_size);
-
-  d = &dest->words[nwords_old - 1];
-  f = source->words;
-
-  count = nwords_new - nwords_old;
-
-//if(lvl==0)
-//	printf("old:%u, new: %u, count: %u, desp: %u, corr: %u\n", nwords_old, nwords_new, count, desp, corr);
-
-  if (desp + source->num_of_bits <= WORD_SIZE) {
-    *d |= (*f << desp);
-  } else {
-    while (count--) {
-      *d++ |= (*f << desp);
-      if(corr != WORD_SIZE){
-        *d = *f >> corr;
-    *f++;
-    }
-      else
-        *f++;
-
-    }
-
-//    printf("corr: %u, x: %u\n", corr, (source->num_of_bits%WORD_SIZE));
-
-    if(corr == WORD_SIZE)
-        *d |= (*f << desp);
-
-//    if((new_size%WORD_SIZE) != 0){
-//    else if((count > 1) && source->num_of_bits > WORD_SIZE){
-    else if(corr >= (source->num_of_bits%WORD_SIZE)){
-       word_t aux = *f;
-
-       *d |= aux << desp;
-    }
-  }
- }
+  bit_array_copy_range(dest, from, source, 0, source->num_of_bits);
 }
 
 void bit_array_concat_from_to(BIT_ARRAY* dest, BIT_ARRAY* source, unsigned int shift, unsigned int from, unsigned int len) {
-//printf("shift:%u, from:%u, len:%u, ", shift, from, len);
-
-  if((source->num_of_bits <= 0) || (len <= 0)) return;
-
-  unsigned int desp, corr, sdesp, scorr, num_shifts, i;
-  unsigned int len_aux = len;
-  word_t *d, *f;
-  unsigned int aux = 0;
-
-  d = &dest->words[nwords(shift + 1) - 1];
-  f = &source->words[nwords(from + 1) - 1];
-
-  desp = shift % WORD_SIZE; // Position to start to write in dest (lower value: 0, upper value: 31)
-  corr = WORD_SIZE - desp; // Number of free positions in dest including the start position (lower value: 1, upper value: 32)
-
-  sdesp = from % WORD_SIZE; // Position to start to read from the source (lower value: 0, upper value: 31)
-  scorr = WORD_SIZE - sdesp; // Number of positions since the start position of the source, including the start position (lower value:1, upper value: 32)
-
-  if(sdesp > 0) {
-    if(corr > scorr) {
-      if(len_aux < scorr) {
-        *d |= (((*f << (scorr - len_aux)) >> (WORD_SIZE - len_aux)) << desp);
-        return;
-      }
-
-      *d |= ((*f >> sdesp) << desp);
-      desp = desp + scorr;
-      corr = WORD_SIZE - desp;
-    }
-    else if(corr < scorr) {
-      if(len_aux < corr) {
-        *d |= (((*f << (scorr - len_aux)) >> (WORD_SIZE - len_aux)) << desp);
-        return;
-      }
-
-      *d |= ((*f >> sdesp) << desp);
-      *d++;
-
-      if(len_aux < scorr) {
-        if((WORD_SIZE  - len_aux + corr) < WORD_SIZE ) // (?)
-      *d |= ((*f << (scorr - len_aux)) >> (WORD_SIZE  - len_aux + corr));
-        return;
-      }
-
-      if((sdesp + corr) < WORD_SIZE)
-        *d |= (*f >> (sdesp + corr));
-      desp = scorr - corr;
-      corr = WORD_SIZE - desp;
-    }
-    else if(corr == scorr) { // Implies desp == sdesp
-      if(len_aux < corr) {
-        if((scorr - len_aux + sdesp) < WORD_SIZE)
-          *d |= (((*f << (scorr - len_aux)) >> (scorr - len_aux + sdesp)) << desp);
-        return;
-      }
-      *d |= ((*f >> sdesp) << desp);
-      *d++;
-      desp = (desp + corr)%WORD_SIZE; // Always desp = 0 in this case;
-      corr = WORD_SIZE - desp;
-    }
-
-    len_aux -= scorr;
-  }
-
-
-  // Until here, we force the case sdesp=0. Therefore, it's necessary redefine
-  // desp and corr, depending the case
-
-  num_shifts = ((len_aux + desp - 1)/WORD_SIZE) + 1;
-
-  for(i = 0; i < num_shifts; i++) {
-    // General copy of bits using "desp" and "corr"
-
-    if(len_aux <= 0) {
-      return;
-    }
-
-    if((i>0) || (sdesp > 0)) // It implies that it satisfied the previous condition (sdesp > 0)
-      *f++;
-
-    if(len_aux <= corr) {
-      *d |= (((*f << ( WORD_SIZE - len_aux)) >> (WORD_SIZE - len_aux)) << desp);
-      return;
-    }
-
-    // Strange behavior with desp = WORD_SIZE (Is it necessary?)
-    *d |= (*f << desp);
-
-    len_aux -= corr;
-    *d++;
-
-    if(len_aux <= desp) {
-      *d |= ((*f << (desp - len_aux)) >> (WORD_SIZE - len_aux));
-      return;
-    }
-
-    // Strange behavior with corr = WORD_SIZE
-    if(corr < WORD_SIZE)
-        *d |= (*f >> corr);
-
-    len_aux -= desp;
-
-  }
-
-//printf("%s (*d)\n", bit_array_to_string(&((BIT_ARRAY){d, 32})));
+  bit_array_copy_range(dest, shift, source, from, len);
 }
-
-
-/* Thread-safe version of bit_array_concat_from_to() */
-/*
-void parallel_bit_array_concat_from_to(BIT_ARRAY* dest, BIT_ARRAY* source, unsigned int shift, unsigned int from, unsigned int len) {
-
-  if((source->num_of_bits <= 0) || (len <= 0)) return;
-
-  unsigned int desp, corr, sdesp, scorr, num_shifts, i;
-  unsigned int len_aux = len;
-  word_t *d, *f;
-  word_t old_d, new_d; // Thread safe shifting
-  unsigned int aux = 0;
-
-  d = &dest->words[nwords(shift + 1) - 1];
-  f = &source->words[nwords(from + 1) - 1];
-
-  desp = shift % WORD_SIZE; // Position to start to write in dest (lower value: 0, upper value: 31)
-  corr = WORD_SIZE - desp; // Number of free positions in dest including the start position (lower value: 1, upper value: 32)
-
-  sdesp = from % WORD_SIZE; // Position to start to read from the source (lower value: 0, upper value: 31)
-  scorr = WORD_SIZE - sdesp; // Number of positions since the start position of the source, including the start position (lower value:1, upper value: 32)
-
-  if(sdesp > 0) {
-    if(corr > scorr) {
-      if(len_aux < scorr) {
-        do{
-          old_d = *d;
-          new_d = old_d | (((*f << (scorr - len_aux)) >> (WORD_SIZE - len_aux)) << desp);
-        }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-        return;
-      }
-
-      do{
-        old_d = *d;
-        new_d = old_d | ((*f >> sdesp) << desp);
-      }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-      desp = desp + scorr;
-      corr = WORD_SIZE - desp;
-    }
-    else if(corr < scorr) {
-      if(len_aux < corr) {
-        do{
-          old_d = *d;
-          new_d = old_d | (((*f << (scorr - len_aux)) >> (WORD_SIZE - len_aux)) << desp);
-        }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-        return;
-      }
-
-      do{
-        old_d = *d;
-        new_d = old_d | ((*f >> sdesp) << desp);
-      }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-
-      *d++;
-
-      if(len_aux < scorr) {
-        if((WORD_SIZE  - len_aux + corr) < WORD_SIZE ) {
-          do{
-            old_d = *d;
-            new_d = old_d | ((*f << (scorr - len_aux)) >> (WORD_SIZE  - len_aux + corr));
-          }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-        }
-        return;
-      }
-
-      if((sdesp + corr) < WORD_SIZE) {
-        do{
-          old_d = *d;
-          new_d = old_d | (*f >> (sdesp + corr));
-        }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-      }
-      desp = scorr - corr;
-      corr = WORD_SIZE - desp;
-    }
-    else if(corr == scorr) { // Implies desp == sdesp
-      if(len_aux < corr) {
-        if((scorr - len_aux + sdesp) < WORD_SIZE) {
-          do{
-            old_d = *d;
-            new_d = old_d | (((*f << (scorr - len_aux)) >> (scorr - len_aux + sdesp)) << desp);
-          }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-        }
-        return;
-      }
-
-      do{
-        old_d = *d;
-        new_d = old_d | ((*f >> sdesp) << desp);
-      }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-
-      *d++;
-      desp = (desp + corr)%WORD_SIZE; // Always desp = 0 in this case;
-      corr = WORD_SIZE - desp;
-    }
-
-    len_aux -= scorr;
-  }
-
-
-  // Until here, we force the case sdesp=0. Therefore, it's necessary redefine
-  // desp and corr, depending the case
-
-  num_shifts = ((len_aux + desp - 1)/WORD_SIZE) + 1;
-
-  for(i = 0; i < num_shifts; i++) {
-    // General copy of bits using "desp" and "corr"
-
-    if(len_aux <= 0) {
-      return;
-    }
-
-    if((i>0) || (sdesp > 0)) // It implies that it satisfied the previous condition (sdesp > 0)
-      *f++;
-
-    if(len_aux <= corr) {
-      do{
-        old_d = *d;
-        new_d = old_d | (((*f << ( WORD_SIZE - len_aux)) >> (WORD_SIZE - len_aux)) << desp);
-      }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-      return;
-    }
-
-    do{
-      old_d = *d;
-      new_d = old_d | (*f << desp);
-    }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-
-    len_aux -= corr;
-    *d++;
-
-    if(len_aux <= desp) {
-      do{
-        old_d = *d;
-        new_d = old_d | ((*f << (desp - len_aux)) >> (WORD_SIZE - len_aux));
-      }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-      return;
-    }
-
-    // Strange behavior with corr = WORD_SIZE
-    if(corr < WORD_SIZE) {
-      do{
-        old_d = *d;
-        new_d = old_d | (*f >> corr);
-      }while(!(__atomic_compare_exchange_n(d, &old_d, new_d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)));
-    }
-
-    len_aux -= desp;
-  }
-}
-*/
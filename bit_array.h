@@ -89,6 +89,22 @@ char* bit_array_to_string(BIT_ARRAY* bitarr);
 // Copy a BIT_ARRAY struct and the data it holds - returns pointer to new object
 BIT_ARRAY* bit_array_clone(BIT_ARRAY* bitarr);
 
+// Copy of the bits [from, from+len) in a new bit array
+BIT_ARRAY* bit_array_extract(BIT_ARRAY* bitarr, bit_index_t from, bit_index_t len);
+
+// Copy the bits [src_off, src_off+len) of src to [dst_off, dst_off+len) of
+// dest, 64 bits at a time (memmove when both offsets are word aligned).
+// Other bits of dest are kept. dest and src may be the same array, with
+// overlapping ranges
+void bit_array_copy_range(BIT_ARRAY* dest, bit_index_t dst_off,
+                          BIT_ARRAY* src, bit_index_t src_off, bit_index_t len);
+// Parallel version: the 64-bit words of dest are split among the threads,
+// so it needs no atomics. Copies of different ranges into the same dest
+// are safe in parallel only if they do not share a 64-bit word
+void parallel_bit_array_copy_range(BIT_ARRAY* dest, bit_index_t dst_off,
+                                   BIT_ARRAY* src, bit_index_t src_off,
+                                   bit_index_t len);
+
 // Copy the data it holds
 // Handles overlaps properly if dest == src
 //void bit_array_copy(BIT_ARRAY* dest, bit_index_t dstindx,
@@ -111,6 +127,9 @@ void bit_array_or(BIT_ARRAY* dest, BIT_ARRAY* src1, BIT_ARRAY* src2);
 void bit_array_xor(BIT_ARRAY* dest, BIT_ARRAY* src1, BIT_ARRAY* src2);
 void bit_array_not(BIT_ARRAY* dest, BIT_ARRAY* src);
 
+// dest = src1 & src2 (dest may be NULL) and number of ones of the result
+unsigned long bit_array_and_count(BIT_ARRAY* dest, BIT_ARRAY* src1, BIT_ARRAY* src2);
+
 // Compare two bit arrays by value stored
 // arrays do not have to be the same length (e.g. 101 (5) > 00000011 (3))
 int bit_array_compare(BIT_ARRAY* bitarr1, BIT_ARRAY* bitarr2);
@@ -138,8 +157,9 @@ void bit_array_save(BIT_ARRAY* bitarr, FILE* f);
 // add bits from orig to dest, also replace dest with the new version
 // this is like a += x (you lost the old value in a)
 void bit_array_concat(BIT_ARRAY *dest, BIT_ARRAY *orig); //fast version
-void bit_array_concat_from(BIT_ARRAY *, BIT_ARRAY *, int , int, int, int); //ultrafast version
-void parallel_bit_array_concat_from_to(BIT_ARRAY *, BIT_ARRAY *, unsigned int , unsigned int, unsigned int); // Thread Safe
-void bit_array_concat_from_to(BIT_ARRAY *, BIT_ARRAY *, unsigned int , unsigned int, unsigned int);
+// Wrappers of bit_array_copy_range: all of orig at position from of dest,
+// and len bits of orig from position from at position shift of dest
+void bit_array_concat_from(BIT_ARRAY *dest, BIT_ARRAY *orig, int from, int lvl, int node, int thread);
+void bit_array_concat_from_to(BIT_ARRAY *dest, BIT_ARRAY *orig, unsigned int shift, unsigned int from, unsigned int len);
 void bit_array_concat_slow(BIT_ARRAY *dest, BIT_ARRAY *orig);
 #endif
@@ -0,0 +1,346 @@
+/******************************************************************************
+ * bp_input.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "bp_input.h"
+#include "util.h"
+#include "basic.h"
+
+/*
+ * Sources of decompressed bytes
+ */
+
+struct source {
+  gzFile gz; // Plain or gzip files
+  int error; // A read failed (the rest of the file is not read)
+#ifdef HAVE_ZSTD
+  FILE* fp;
+  ZSTD_DStream* zstd;
+  ZSTD_inBuffer in;
+  char* in_buf;
+  int eof; // All the input was read
+#endif
+};
+
+// It returns -1 if the file cannot be read
+static int open_source(struct source* src, const char* fn) {
+  src->gz = NULL;
+  src->error = 0;
+
+  // zlib passes unknown formats through as plain bytes, so zstd files are
+  // recognized by their magic number even without zstd support
+  unsigned char magic[4] = {0};
+  FILE* fp = fopen(fn, "rb");
+  if(fp && fread(magic, 1, 4, fp) == 4 && magic[0] == 0x28 &&
+     magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+#ifdef HAVE_ZSTD
+    rewind(fp);
+    src->fp = fp;
+    src->zstd = ZSTD_createDStream();
+    ZSTD_initDStream(src->zstd);
+    src->in_buf = (char*)malloc(ZSTD_DStreamInSize());
+    src->in.src = src->in_buf;
+    src->in.size = src->in.pos = 0;
+    src->eof = 0;
+    return 0;
+#else
+    fprintf(stderr, "Error: \"%s\" is a zstd file, compile with -DHAVE_ZSTD -lzstd.\n", fn);
+    fclose(fp);
+    return -1;
+#endif
+  }
+  if(fp)
+    fclose(fp);
+#ifdef HAVE_ZSTD
+  src->fp = NULL;
+  src->zstd = NULL;
+  src->in_buf = NULL;
+#endif
+
+  src->gz = gzopen(fn, "rb");
+  if(!src->gz) {
+    fprintf(stderr, "Error opening file \"%s\".\n", fn);
+    return -1;
+  }
+  gzbuffer(src->gz, 256*1024);
+  return 0;
+}
+
+// It fills buf with up to len bytes. It returns the number of bytes read,
+// less than len only at the end of the file or after an error
+static size_t read_source(struct source* src, char* buf, size_t len) {
+#ifdef HAVE_ZSTD
+  if(src->zstd) {
+    ZSTD_outBuffer out = {buf, len, 0};
+    while(out.pos < out.size) {
+      if(src->in.pos == src->in.size && !src->eof) {
+	src->in.size = fread(src->in_buf, 1, ZSTD_DStreamInSize(), src->fp);
+	src->in.pos = 0;
+	src->eof = src->in.size == 0;
+      }
+      // After the end of the input it only flushes the decoder
+      size_t before = out.pos;
+      size_t r = ZSTD_decompressStream(src->zstd, &out, &src->in);
+      if(ZSTD_isError(r)) {
+	fprintf(stderr, "Error: %s\n", ZSTD_getErrorName(r));
+	src->error = 1;
+	break;
+      }
+      if(src->eof && out.pos == before) {
+	if(r != 0) { // The last frame is incomplete
+	  fprintf(stderr, "Error: Truncated zstd file\n");
+	  src->error = 1;
+	}
+	break;
+      }
+    }
+    return out.pos;
+  }
+#endif
+
+  size_t total = 0;
+  while(total < len) {
+    int r = gzread(src->gz, buf + total, len - total);
+    if(r < 0) {
+      int err;
+      fprintf(stderr, "Error: %s\n", gzerror(src->gz, &err));
+      src->error = 1;
+      break;
+    }
+    if(r == 0) { // A truncated gzip file ends with Z_BUF_ERROR
+      int err;
+      const char* msg = gzerror(src->gz, &err);
+      if(err == Z_BUF_ERROR) {
+	fprintf(stderr, "Error: %s\n", msg);
+	src->error = 1;
+      }
+      break;
+    }
+    total += r;
+  }
+  return total;
+}
+
+static void close_source(struct source* src) {
+#ifdef HAVE_ZSTD
+  if(src->zstd) {
+    ZSTD_freeDStream(src->zstd);
+    free(src->in_buf);
+    fclose(src->fp);
+    return;
+  }
+#endif
+  gzclose(src->gz);
+}
+
+/*
+ * Bounded queue between the reader thread and the packing thread
+ */
+
+struct pipeline {
+  struct source src;
+  char* blocks[INPUT_QUEUE];
+  size_t lens[INPUT_QUEUE];
+  int head, count, done;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty, not_full;
+};
+
+static void* reader(void* arg) {
+  struct pipeline* p = (struct pipeline*)arg;
+  int tail = 0;
+
+  for(;;) {
+    pthread_mutex_lock(&p->lock);
+    while(p->count == INPUT_QUEUE)
+      pthread_cond_wait(&p->not_full, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+
+    // The slot is free until it is published
+    size_t len = read_source(&p->src, p->blocks[tail], INPUT_BLOCK);
+
+    pthread_mutex_lock(&p->lock);
+    p->lens[tail] = len;
+    if(len > 0)
+      p->count++;
+    if(len < INPUT_BLOCK)
+      p->done = 1;
+    pthread_cond_signal(&p->not_empty);
+    pthread_mutex_unlock(&p->lock);
+
+    if(len < INPUT_BLOCK)
+      return NULL;
+    tail = (tail + 1) % INPUT_QUEUE;
+  }
+}
+
+// Summaries of the chunks, grown with the input
+struct leaves {
+  unsigned int log_s; // Chunks of 2^log_s parentheses
+  unsigned long cap;
+  depth_t *e, *m, *M;
+  int16_t* num_mins;
+};
+
+// It returns NULL if the file cannot be read
+static BIT_ARRAY* run_pipeline(const char* fn, long* n, struct leaves* leaves) {
+  struct pipeline p;
+  if(open_source(&p.src, fn) < 0)
+    return NULL;
+  for(int b = 0; b < INPUT_QUEUE; b++)
+    p.blocks[b] = (char*)malloc(INPUT_BLOCK);
+  p.head = p.count = p.done = 0;
+  pthread_mutex_init(&p.lock, NULL);
+  pthread_cond_init(&p.not_empty, NULL);
+  pthread_cond_init(&p.not_full, NULL);
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, reader, &p);
+
+  unsigned long cap = INPUT_BLOCK, bits = 0;
+  BIT_ARRAY* B = (BIT_ARRAY*)malloc(sizeof(BIT_ARRAY));
+  B->words = (word_t*)malloc(cap/8);
+  B->num_of_bits = 0;
+
+  for(;;) {
+    pthread_mutex_lock(&p.lock);
+    while(p.count == 0 && !p.done)
+      pthread_cond_wait(&p.not_empty, &p.lock);
+    if(p.count == 0) { // done
+      pthread_mutex_unlock(&p.lock);
+      break;
+    }
+    pthread_mutex_unlock(&p.lock);
+
+    char* block = p.blocks[p.head];
+    size_t len = p.lens[p.head];
+
+    if(bits + len > cap) {
+      cap *= 2;
+      B->words = (word_t*)realloc(B->words, cap/8);
+    }
+
+    // Bit packing. Blocks start at a word boundary
+    word_t* words = B->words + bits/(word_size);
+    unsigned long num_words = (len + (word_size) - 1)/(word_size);
+    cilk_for(unsigned long w = 0; w < num_words; w++) {
+      unsigned long ul = min((w+1)*(word_size), len);
+      word_t word = 0;
+      for(unsigned long c = w*(word_size); c < ul; c++)
+	word |= (word_t)(block[c] == '(') << (c % (word_size));
+      words[w] = word;
+    }
+
+    unsigned long start = bits;
+    bits += len;
+    B->num_of_bits = bits;
+
+    // STEP 2.1 on the chunks of the block. Blocks start at a chunk boundary
+    if(leaves) {
+      unsigned long s = 1UL << leaves->log_s;
+      unsigned long first = start >> leaves->log_s;
+      unsigned long last = (bits + s - 1) >> leaves->log_s;
+      if(last > leaves->cap) {
+	leaves->cap = max(2*leaves->cap, last);
+	leaves->e = (depth_t*)realloc(leaves->e, leaves->cap*sizeof(depth_t));
+	leaves->m = (depth_t*)realloc(leaves->m, leaves->cap*sizeof(depth_t));
+	leaves->M = (depth_t*)realloc(leaves->M, leaves->cap*sizeof(depth_t));
+	leaves->num_mins = (int16_t*)realloc(leaves->num_mins, leaves->cap*sizeof(int16_t));
+      }
+      cilk_for(unsigned long chunk = first; chunk < last; chunk++)
+	st_chunk_summary(B, chunk*s, min((chunk+1)*s, bits), &leaves->e[chunk],
+			 &leaves->m[chunk], &leaves->M[chunk], &leaves->num_mins[chunk]);
+    }
+
+    pthread_mutex_lock(&p.lock);
+    p.count--;
+    p.head = (p.head + 1) % INPUT_QUEUE;
+    pthread_cond_signal(&p.not_full);
+    pthread_mutex_unlock(&p.lock);
+  }
+
+  pthread_join(thread, NULL);
+  close_source(&p.src);
+  for(int b = 0; b < INPUT_QUEUE; b++)
+    free(p.blocks[b]);
+  pthread_mutex_destroy(&p.lock);
+  pthread_cond_destroy(&p.not_empty);
+  pthread_cond_destroy(&p.not_full);
+
+  if(p.src.error) {
+    bit_array_free(B);
+    return NULL;
+  }
+
+  *n = bits;
+  return B;
+}
+
+BIT_ARRAY* bp_input_read(const char* fn, long* n) {
+  BIT_ARRAY* B = run_pipeline(fn, n, NULL);
+  if(!B)
+    exit(-1);
+  return B;
+}
+
+rmMt* bp_input_load(const char* fn, BIT_ARRAY** B, long* n) {
+  st_config_init();
+  struct leaves leaves = {st_conf.log_s, 0, NULL, NULL, NULL, NULL};
+  *B = run_pipeline(fn, n, &leaves);
+
+  rmMt* st = NULL;
+  if(*B && *n == 0) {
+    fprintf(stderr, "Error: Empty input\n");
+    bit_array_free(*B);
+    *B = NULL;
+  }
+  else if(*B)
+    st = st_create_from_chunks(*B, *n, leaves.log_s, leaves.e, leaves.m,
+			       leaves.M, leaves.num_mins);
+
+  free(leaves.e);
+  free(leaves.m);
+  free(leaves.M);
+  free(leaves.num_mins);
+
+  return st;
+}
+
+rmMt* bp_input_create(const char* fn, BIT_ARRAY** B, long* n) {
+  rmMt* st = bp_input_load(fn, B, n);
+  if(!st)
+    exit(-1);
+  return st;
+}
@@ -0,0 +1,55 @@
+/******************************************************************************
+ * bp_input.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef BP_INPUT_H
+#define BP_INPUT_H
+
+#include "bit_array.h"
+#include "succinct_tree.h"
+
+// Pipelined reading of parentheses files. Plain and gzip files are read
+// with zlib, and zstd files too if compiled with -DHAVE_ZSTD (build.sh
+// detects libzstd with pkg-config; without it zstd files are an error). A
+// reader thread decompresses blocks of INPUT_BLOCK bytes into a queue of
+// INPUT_QUEUE blocks while the calling thread packs the bits of the previous
+// blocks, so I/O, decoding and packing overlap
+#define INPUT_BLOCK (1 << 20) // A multiple of the chunk size
+#define INPUT_QUEUE 4
+
+// Like parentheses_to_bits, for compressed files too. Errors exit
+BIT_ARRAY* bp_input_read(const char* fn, long* n);
+
+// It also computes the leaves of the min-max tree (STEP 2.1) on each block
+// as soon as it is packed, so only STEPS 2.2 and 2.3 remain after the last
+// block. The bit array is returned in B
+rmMt* bp_input_create(const char* fn, BIT_ARRAY** B, long* n);
+// Like bp_input_create, but it returns NULL (and *B = NULL) instead of
+// exiting if the file cannot be opened or decoded or if it is empty
+rmMt* bp_input_load(const char* fn, BIT_ARRAY** B, long* n);
+
+#endif // BP_INPUT_H
@@ -2,19 +2,42 @@
 
 # ToDo: Check queries for -DARCH64
 
-DEFS_SEQ="-std=gnu99 -ffast-math -DNOPARALLEL -DEXTRA"
-DEFS_PAR="-std=gnu99 -ffast-math -DEXTRA"
-DEFS_MEM="-std=gnu99 -ffast-math -DNOPARALLEL -DEXTRA -DMALLOC_COUNT"
+# zstd input files need libzstd
+ZSTD_DEFS=""
+ZSTD_LIBS=""
+if pkg-config --exists libzstd 2>/dev/null; then
+  ZSTD_DEFS="-DHAVE_ZSTD $(pkg-config --cflags libzstd)"
+  ZSTD_LIBS="$(pkg-config --libs libzstd)"
+else
+  echo "libzstd not found, zstd input files are not supported"
+fi
 
-gcc -O2 -c bit_array.c
+DEFS_SEQ="-std=gnu99 -ffast-math -DNOPARALLEL -DEXTRA $ZSTD_DEFS"
+DEFS_PAR="-std=gnu99 -ffast-math -DEXTRA $ZSTD_DEFS"
+DEFS_MEM="-std=gnu99 -ffast-math -DNOPARALLEL -DEXTRA -DMALLOC_COUNT $ZSTD_DEFS"
 
 echo "Compiling sequential algorithm ..."
-gcc -O2 -o st_seq $DEFS_SEQ main.c util.c bit_array.o succinct_tree.c lookup_tables.c -lrt -lm
+gcc -O2 -o st_seq $DEFS_SEQ main.c util.c basic.c bit_array.c succinct_tree.c lookup_tables.c batch_queries.c forest.c rank_bitmap.c wavelet_matrix.c labeled_tree.c trie.c rmq.c subtree_agg.c tree_dp.c subtree_hash.c rle_bp.c bp_input.c query_log.c index_handle.c -lrt -lm -lz $ZSTD_LIBS -lpthread
 
 echo "Compiling parallel algorithm ..."
-gcc -O2 -o st_par $DEFS_PAR main.c util.c bit_array.o succinct_tree.c lookup_tables.c -fcilkplus -lcilkrts -lrt -lm 
+gcc -O2 -o st_par $DEFS_PAR main.c util.c basic.c bit_array.c succinct_tree.c lookup_tables.c batch_queries.c forest.c rank_bitmap.c wavelet_matrix.c labeled_tree.c trie.c rmq.c subtree_agg.c tree_dp.c subtree_hash.c rle_bp.c bp_input.c query_log.c index_handle.c -fcilkplus -lcilkrts -lrt -lm -lz $ZSTD_LIBS -lpthread 
+
+echo "Compiling query benchmark ..."
+gcc -O2 -o st_query $DEFS_PAR query_bench.c util.c basic.c bit_array.c succinct_tree.c lookup_tables.c batch_queries.c forest.c rank_bitmap.c wavelet_matrix.c labeled_tree.c trie.c rmq.c subtree_agg.c tree_dp.c subtree_hash.c rle_bp.c bp_input.c query_log.c index_handle.c -fcilkplus -lcilkrts -lrt -lm -lz $ZSTD_LIBS -lpthread
+
+echo "Compiling construction scaling benchmark ..."
+gcc -O2 -o st_scale $DEFS_PAR scale_bench.c util.c basic.c bit_array.c succinct_tree.c lookup_tables.c batch_queries.c forest.c rank_bitmap.c wavelet_matrix.c labeled_tree.c trie.c rmq.c subtree_agg.c tree_dp.c subtree_hash.c rle_bp.c bp_input.c query_log.c index_handle.c -fcilkplus -lcilkrts -lrt -lm -lz $ZSTD_LIBS -lpthread
+
+echo "Compiling autotuner ..."
+gcc -O2 -o st_autotune $DEFS_PAR autotune.c util.c basic.c bit_array.c succinct_tree.c lookup_tables.c batch_queries.c forest.c rank_bitmap.c wavelet_matrix.c labeled_tree.c trie.c rmq.c subtree_agg.c tree_dp.c subtree_hash.c rle_bp.c bp_input.c query_log.c index_handle.c -fcilkplus -lcilkrts -lrt -lm -lz $ZSTD_LIBS -lpthread
+
+echo "Compiling query benchmark with query log (ST_QUERY_LOG=<log file>) ..."
+gcc -O2 -o st_query_log $DEFS_PAR -DQUERY_LOG query_bench.c util.c basic.c bit_array.c succinct_tree.c lookup_tables.c batch_queries.c forest.c rank_bitmap.c wavelet_matrix.c labeled_tree.c trie.c rmq.c subtree_agg.c tree_dp.c subtree_hash.c rle_bp.c bp_input.c query_log.c index_handle.c -fcilkplus -lcilkrts -lrt -lm -lz $ZSTD_LIBS -lpthread
+
+echo "Compiling query log replay ..."
+gcc -O2 -o st_replay $DEFS_PAR replay.c util.c basic.c bit_array.c succinct_tree.c lookup_tables.c batch_queries.c forest.c rank_bitmap.c wavelet_matrix.c labeled_tree.c trie.c rmq.c subtree_agg.c tree_dp.c subtree_hash.c rle_bp.c bp_input.c query_log.c index_handle.c -fcilkplus -lcilkrts -lrt -lm -lz $ZSTD_LIBS -lpthread
 
 echo "Compiling sequential algorithm (Working space) ..."
 gcc -c malloc_count.c
-gcc -O2 -std=gnu99 -o st_mem $DEFS_MEM main.c util.c bit_array.o malloc_count.o \
-succinct_tree.c lookup_tables.c -lrt -lm -ldl
+gcc -O2 -std=gnu99 -o st_mem $DEFS_MEM main.c util.c basic.c bit_array.c malloc_count.o \
+succinct_tree.c lookup_tables.c batch_queries.c forest.c rank_bitmap.c wavelet_matrix.c labeled_tree.c trie.c rmq.c subtree_agg.c tree_dp.c subtree_hash.c rle_bp.c bp_input.c query_log.c index_handle.c -lrt -lm -lz $ZSTD_LIBS -lpthread -ldl
@@ -0,0 +1,270 @@
+/******************************************************************************
+ * forest.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "forest.h"
+#include "bit_array.h"
+#include "util.h"
+#include "basic.h"
+
+// Byte of B that starts at position j (j multiple of 8)
+static inline uint8_t get_byte(BIT_ARRAY* B, long j) {
+  return (B->words[j>>logW] >> (j&(word_size-1))) & 0xFF;
+}
+
+/*
+ * Direct scans for tiny documents. They only use the universal tables
+ */
+
+// Smallest j in (i, end) with E(j) = E(i)-1, or -1
+static int32_t tiny_fwd(BIT_ARRAY* B, long i, long end) {
+  int32_t excess = 0; // E(j) - E(i)
+  long j = i+1;
+
+  for(; j < end && (j&7); j++) {
+    excess += 2*bit_array_get_bit(B,j)-1;
+    if(excess == -1)
+      return j;
+  }
+
+  for(; j+8 <= end; j+=8) {
+    uint8_t w = get_byte(B, j);
+    int32_t desired = -1 - excess; // desired is always negative
+    if(desired >= -8) {
+      int8_t x = T->near_fwd_pos[((desired+8)<<8) + w];
+      if(x < 8)
+	return j+x;
+    }
+    excess += T->word_sum[w];
+  }
+
+  for(; j < end; j++) {
+    excess += 2*bit_array_get_bit(B,j)-1;
+    if(excess == -1)
+      return j;
+  }
+
+  return -1;
+}
+
+// Largest q in [begin-1, i-1] with E(q) = E(i)+delta, and it returns q+1 (or
+// -1). All the excess values in (q, i] must be greater than E(i)+delta, so
+// delta must be negative
+static int32_t tiny_bwd(BIT_ARRAY* B, long begin, long i, int32_t delta) {
+  int32_t excess = 0; // E(j-1) - E(i) after processing position j
+  long j = i;
+
+  for(; j >= begin && ((j+1)&7); j--) {
+    excess -= 2*bit_array_get_bit(B,j)-1;
+    if(excess == delta)
+      return j;
+  }
+
+  for(; j-7 >= begin; j-=8) {
+    uint8_t w = get_byte(B, j-7);
+    int32_t before = excess - T->word_sum[w]; // Excess before the byte
+    // Excess values inside the byte are contiguous, so the answer is in this
+    // byte iff its minimum reaches delta
+    if(before + min(0, T->min[w]) <= delta)
+      break;
+    excess = before;
+  }
+
+  for(; j >= begin; j--) {
+    excess -= 2*bit_array_get_bit(B,j)-1;
+    if(excess == delta)
+      return j;
+  }
+
+  return -1;
+}
+
+// Excess at position i of a tiny document (relative to its beginning)
+static int32_t tiny_depth(BIT_ARRAY* B, long begin, long i) {
+  int32_t excess = 0;
+  long j = begin;
+
+  for(; j <= i && (j&7); j++)
+    excess += 2*bit_array_get_bit(B,j)-1;
+  for(; j+7 <= i; j+=8)
+    excess += T->word_sum[get_byte(B, j)];
+  for(; j <= i; j++)
+    excess += 2*bit_array_get_bit(B,j)-1;
+
+  return excess;
+}
+
+/*
+ * Construction
+ */
+
+#define PACK_BLOCK (1UL << 16) // Bits of the packed BP per parallel task
+
+st_forest* st_forest_create_packed(BIT_ARRAY* B, unsigned long* offsets, unsigned long num_docs) {
+  st_forest* f = (st_forest*)malloc(sizeof(st_forest));
+  f->num_docs = num_docs;
+  f->offsets = offsets;
+  f->bit_array = B;
+  f->st = NULL;
+
+  // One pass over all the documents (STEP 2 of st_create)
+  if(offsets[num_docs] > 0)
+    f->st = st_create(B, offsets[num_docs]);
+
+  return f;
+}
+
+st_forest* st_forest_create(BIT_ARRAY** docs, unsigned long* sizes, unsigned long num_docs) {
+  unsigned long* offsets = (unsigned long*)malloc((num_docs+1)*sizeof(unsigned long));
+
+  offsets[0] = 0;
+  for(unsigned long d = 0; d < num_docs; d++)
+    offsets[d+1] = offsets[d] + sizes[d];
+
+  // The packed BP is split in blocks of whole 64-bit words, and each block
+  // copies the parts of the documents that fall in it
+  BIT_ARRAY* B = bit_array_create(offsets[num_docs]);
+  unsigned long num_blocks = (offsets[num_docs] + PACK_BLOCK - 1)/PACK_BLOCK;
+  cilk_for(unsigned long b = 0; b < num_blocks; b++) {
+    unsigned long lo = b*PACK_BLOCK, hi = min(lo + PACK_BLOCK, offsets[num_docs]);
+
+    // First document that ends after lo
+    unsigned long l = 0, r = num_docs;
+    while(l < r) {
+      unsigned long mid = (l + r)/2;
+      if(offsets[mid+1] <= lo)
+	l = mid + 1;
+      else
+	r = mid;
+    }
+
+    for(unsigned long d = l; d < num_docs && offsets[d] < hi; d++) {
+      unsigned long from = max(offsets[d], lo), to = min(offsets[d+1], hi);
+      if(from < to)
+	bit_array_copy_range(B, from, docs[d], from - offsets[d], to - from);
+    }
+  }
+
+  return st_forest_create_packed(B, offsets, num_docs);
+}
+
+void st_forest_free(st_forest* f) {
+  if(f->st)
+    st_free(f->st);
+  bit_array_free(f->bit_array);
+  free(f->offsets);
+  free(f);
+}
+
+/*
+ * Operations
+ */
+
+unsigned long st_forest_doc_size(st_forest* f, unsigned long d) {
+  return f->offsets[d+1] - f->offsets[d];
+}
+
+static inline int is_tiny(st_forest* f, unsigned long d) {
+  return st_forest_doc_size(f, d) <= FOREST_TINY;
+}
+
+int32_t st_forest_find_close(st_forest* f, unsigned long d, int32_t i) {
+  long g = f->offsets[d] + i;
+
+  if(bit_array_get_bit(f->bit_array, g) == 0)
+    return i;
+
+  if(is_tiny(f, d))
+    return tiny_fwd(f->bit_array, g, f->offsets[d+1]) - f->offsets[d];
+
+  return find_close(f->st, g) - f->offsets[d];
+}
+
+int32_t st_forest_find_open(st_forest* f, unsigned long d, int32_t i) {
+  long g = f->offsets[d] + i;
+
+  if(bit_array_get_bit(f->bit_array, g) == 1)
+    return i;
+
+  if(is_tiny(f, d))
+    return tiny_bwd(f->bit_array, f->offsets[d], g-1, -1) - f->offsets[d];
+
+  return find_open(f->st, g) - f->offsets[d];
+}
+
+int32_t st_forest_parent(st_forest* f, unsigned long d, int32_t i) {
+  if(!bit_array_get_bit(f->bit_array, f->offsets[d] + i))
+    i = st_forest_find_open(f, d, i);
+
+  // Roots of the document (it may have several)
+  if(i == 0 || st_forest_depth(f, d, i) == 1)
+    return -1;
+
+  long g = f->offsets[d] + i;
+
+  if(is_tiny(f, d))
+    return tiny_bwd(f->bit_array, f->offsets[d], g, -2) - f->offsets[d];
+
+  return parent_t(f->st, g) - f->offsets[d];
+}
+
+int32_t st_forest_depth(st_forest* f, unsigned long d, int32_t i) {
+  // Documents are balanced, so the global excess is the excess in the document
+  if(is_tiny(f, d))
+    return tiny_depth(f->bit_array, f->offsets[d], f->offsets[d] + i);
+
+  return depth(f->st, f->offsets[d] + i);
+}
+
+int32_t st_forest_subtree_size(st_forest* f, unsigned long d, int32_t i) {
+  return (st_forest_find_close(f, d, i) - i + 1)/2;
+}
+
+int32_t st_forest_first_child(st_forest* f, unsigned long d, int32_t i) {
+  long g = f->offsets[d] + i;
+
+  if(g+1 >= f->offsets[d+1] || !bit_array_get_bit(f->bit_array, g))
+    return -1;
+
+  return bit_array_get_bit(f->bit_array, g+1)? i+1 : -1;
+}
+
+int32_t st_forest_next_sibling(st_forest* f, unsigned long d, int32_t i) {
+  if(!bit_array_get_bit(f->bit_array, f->offsets[d] + i))
+    return -1;
+
+  long g = f->offsets[d] + st_forest_find_close(f, d, i);
+
+  // The roots of different documents are not siblings
+  if(g+1 >= f->offsets[d+1] || !bit_array_get_bit(f->bit_array, g+1))
+    return -1;
+
+  return g+1 - f->offsets[d];
+}
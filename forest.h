@@ -0,0 +1,84 @@
+/******************************************************************************
+ * forest.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef FOREST_H
+#define FOREST_H
+
+#include "succinct_tree.h"
+
+// Packed forest: many small trees (documents) stored as one parentheses
+// sequence. The concatenation of balanced sequences is balanced, so a single
+// min-max tree over the whole sequence answers the queries of every document
+// and its summaries are computed in one parallel pass.
+// Documents of at most FOREST_TINY parentheses are queried with a direct scan
+// of the lookup tables, without touching the min-max tree.
+// Positions of the per-document operations are relative to the document.
+#define FOREST_TINY 256
+
+struct st_forest_t {
+  unsigned long num_docs;
+  // Document d is the range [offsets[d], offsets[d+1]) of bit_array
+  unsigned long* offsets;
+  BIT_ARRAY* bit_array;
+  rmMt* st; // NULL if the forest is empty
+};
+
+typedef struct st_forest_t st_forest;
+
+/* Construction */
+
+// It packs num_docs balanced parentheses sequences (docs[d] has sizes[d]
+// bits) and builds the forest. The input bit arrays are not modified
+st_forest* st_forest_create(BIT_ARRAY** docs, unsigned long* sizes, unsigned long num_docs);
+
+// It builds the forest over an already packed sequence B. It takes ownership
+// of B and offsets (num_docs+1 entries, offsets[num_docs] is the total size)
+st_forest* st_forest_create_packed(BIT_ARRAY* B, unsigned long* offsets, unsigned long num_docs);
+
+void st_forest_free(st_forest* f);
+
+/* Operations on document d */
+
+unsigned long st_forest_doc_size(st_forest* f, unsigned long d);
+
+int32_t st_forest_find_close(st_forest* f, unsigned long d, int32_t i);
+int32_t st_forest_find_open(st_forest* f, unsigned long d, int32_t i);
+
+// It returns -1 for the roots of the document (a document may have several
+// top-level trees)
+int32_t st_forest_parent(st_forest* f, unsigned long d, int32_t i);
+int32_t st_forest_depth(st_forest* f, unsigned long d, int32_t i);
+
+// Number of nodes of the subtree of the node that starts at position i
+int32_t st_forest_subtree_size(st_forest* f, unsigned long d, int32_t i);
+
+// They return -1 if there is no such node
+int32_t st_forest_first_child(st_forest* f, unsigned long d, int32_t i);
+int32_t st_forest_next_sibling(st_forest* f, unsigned long d, int32_t i);
+
+#endif // FOREST_H
@@ -0,0 +1,171 @@
+/******************************************************************************
+ * index_handle.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "index_handle.h"
+#include "bp_input.h"
+
+static st_snapshot* snapshot_create(rmMt* st, BIT_ARRAY* B, unsigned long version) {
+  st_snapshot* s = (st_snapshot*)malloc(sizeof(st_snapshot));
+  s->st = st;
+  s->bit_array = B;
+  s->version = version;
+  s->refs = 1; // Reference of the handle
+  return s;
+}
+
+st_handle* st_handle_create(rmMt* st, BIT_ARRAY* B) {
+  st_handle* h = (st_handle*)malloc(sizeof(st_handle));
+  h->current = snapshot_create(st, B, 1);
+  h->epoch = 0;
+  h->readers[0] = h->readers[1] = 0;
+  pthread_mutex_init(&h->publish_lock, NULL);
+  h->rebuilding = 0;
+  h->rebuild_fn = NULL;
+  h->rebuild_result = ST_REBUILD_NONE;
+  return h;
+}
+
+void st_handle_free(st_handle* h) {
+  st_handle_wait(h);
+  st_snapshot_release(h->current);
+  pthread_mutex_destroy(&h->publish_lock);
+  free(h);
+}
+
+st_snapshot* st_handle_acquire(st_handle* h) {
+  // Read section: the reader is counted in the parity of an epoch that did
+  // not change meanwhile, so a publisher that moves past that epoch waits
+  // for it before dropping its reference to the snapshot read here
+  unsigned long epoch;
+  for(;;) {
+    epoch = __atomic_load_n(&h->epoch, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&h->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&h->epoch, __ATOMIC_SEQ_CST) == epoch)
+      break;
+    __atomic_fetch_sub(&h->readers[epoch & 1], 1, __ATOMIC_RELEASE);
+  }
+
+  st_snapshot* s = __atomic_load_n(&h->current, __ATOMIC_SEQ_CST);
+  __atomic_fetch_add(&s->refs, 1, __ATOMIC_RELAXED);
+
+  __atomic_fetch_sub(&h->readers[epoch & 1], 1, __ATOMIC_RELEASE);
+  return s;
+}
+
+void st_snapshot_release(st_snapshot* s) {
+  if(__atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    return;
+
+  st_free(s->st);
+  if(s->bit_array)
+    bit_array_free(s->bit_array);
+  free(s);
+}
+
+unsigned long st_handle_publish(st_handle* h, rmMt* st, BIT_ARRAY* B) {
+  pthread_mutex_lock(&h->publish_lock);
+
+  st_snapshot* old = h->current;
+  st_snapshot* s = snapshot_create(st, B, old->version + 1);
+  __atomic_store_n(&h->current, s, __ATOMIC_SEQ_CST);
+
+  // Readers of the next epoch can only see the new snapshot. Readers of the
+  // current epoch may still be taking a reference to the old one
+  unsigned long epoch = h->epoch;
+  __atomic_store_n(&h->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+  while(__atomic_load_n(&h->readers[epoch & 1], __ATOMIC_SEQ_CST) > 0)
+    sched_yield();
+
+  pthread_mutex_unlock(&h->publish_lock);
+
+  st_snapshot_release(old);
+  return s->version;
+}
+
+static void* rebuild(void* arg) {
+  st_handle* h = (st_handle*)arg;
+  BIT_ARRAY* B;
+  long n;
+  int result = ST_REBUILD_OK;
+
+  rmMt* st = bp_input_load(h->rebuild_fn, &B, &n);
+  if(!st)
+    result = ST_REBUILD_LOAD_ERROR;
+  else {
+    // From the leaves of the min-max tree, without a pass over the bits
+    st_status(st, &h->rebuild_status);
+    if(h->rebuild_status.balanced)
+      st_handle_publish(h, st, B);
+    else {
+      st_free(st);
+      bit_array_free(B);
+      result = ST_REBUILD_UNBALANCED;
+    }
+  }
+
+  __atomic_store_n(&h->rebuild_result, result, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+int st_handle_rebuild(st_handle* h, const char* fn) {
+  if(h->rebuilding)
+    return -1;
+
+  h->rebuild_fn = strdup(fn);
+  h->rebuilding = 1;
+  int last = h->rebuild_result;
+  h->rebuild_result = ST_REBUILD_RUNNING;
+  if(pthread_create(&h->rebuilder, NULL, rebuild, h) != 0) {
+    free(h->rebuild_fn);
+    h->rebuild_fn = NULL;
+    h->rebuilding = 0;
+    h->rebuild_result = last;
+    return -1;
+  }
+
+  return 0;
+}
+
+int st_handle_wait(st_handle* h) {
+  if(h->rebuilding) {
+    pthread_join(h->rebuilder, NULL);
+    free(h->rebuild_fn);
+    h->rebuild_fn = NULL;
+    h->rebuilding = 0;
+  }
+
+  return h->rebuild_result;
+}
+
+int st_handle_rebuild_result(st_handle* h) {
+  return __atomic_load_n(&h->rebuild_result, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,114 @@
+/******************************************************************************
+ * index_handle.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef INDEX_HANDLE_H
+#define INDEX_HANDLE_H
+
+#include <pthread.h>
+
+#include "succinct_tree.h"
+
+// Shared handle of a min-max tree that can be replaced while it is queried
+// (rebuild while serving). Readers acquire a snapshot of the current tree,
+// query it and release it; a new tree is published with an atomic swap, and
+// the old snapshot is freed when its last reader releases it.
+// Snapshots are reference counted. A reader takes its reference inside a
+// short read section guarded by two counters (one per parity of the epoch of
+// the handle), so it never locks. A publisher swaps the tree, moves the
+// handle to the next epoch and waits until the read sections of the previous
+// epoch are over (a few instructions, not the queries) before dropping the
+// reference of the handle to the old snapshot.
+// Lookup tables (T) are shared by all the trees and never reallocated, so
+// they are safe to use during a rebuild.
+
+struct st_snapshot_t {
+  rmMt* st;
+  BIT_ARRAY* bit_array; // Freed with the snapshot (NULL if not owned)
+  unsigned long version; // 1 for the first tree of the handle, then +1
+  long refs;
+};
+
+typedef struct st_snapshot_t st_snapshot;
+
+// Result of a background rebuild
+enum st_rebuild_result {
+  ST_REBUILD_NONE, // No rebuild yet
+  ST_REBUILD_RUNNING,
+  ST_REBUILD_OK, // Published
+  ST_REBUILD_LOAD_ERROR, // The file cannot be read, or it is empty
+  ST_REBUILD_UNBALANCED // Not published, see rebuild_status
+};
+
+struct st_handle_t {
+  st_snapshot* current;
+  unsigned long epoch;
+  long readers[2]; // Read sections in progress, by parity of the epoch
+  pthread_mutex_t publish_lock; // Between publishers only
+
+  // Background rebuild
+  pthread_t rebuilder;
+  int rebuilding;
+  char* rebuild_fn;
+  int rebuild_result; // Of the last rebuild (enum st_rebuild_result)
+  bp_status rebuild_status; // Balance of the last tree that was loaded
+};
+
+typedef struct st_handle_t st_handle;
+
+// The handle takes ownership of st (built by st_create, st_create_lazy,
+// bp_input_create...; not by a builder) and of B, if it is not NULL
+st_handle* st_handle_create(rmMt* st, BIT_ARRAY* B);
+
+// It waits for a background rebuild. No snapshot may be acquired after it,
+// and the current tree is freed once the snapshots still held are released
+void st_handle_free(st_handle* h);
+
+// Current snapshot, valid until st_snapshot_release. It never blocks
+st_snapshot* st_handle_acquire(st_handle* h);
+void st_snapshot_release(st_snapshot* s);
+
+// It publishes a new tree (same ownership as st_handle_create). Queries in
+// flight finish on the old tree. It returns the version of the new snapshot
+unsigned long st_handle_publish(st_handle* h, rmMt* st, BIT_ARRAY* B);
+
+// It builds the tree of a parentheses file (bp_input_load) in a new thread
+// and publishes it if it is balanced. A file that cannot be loaded or an
+// unbalanced tree leave the current tree in place. It returns -1 if a
+// rebuild is already running. Rebuilds are started and waited for by a
+// single thread
+int st_handle_rebuild(st_handle* h, const char* fn);
+
+// It waits for the background rebuild (if any) and returns the result of the
+// last rebuild
+int st_handle_wait(st_handle* h);
+
+// Result of the last rebuild, without waiting (ST_REBUILD_RUNNING while it
+// runs)
+int st_handle_rebuild_result(st_handle* h);
+
+#endif // INDEX_HANDLE_H
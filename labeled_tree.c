@@ -0,0 +1,146 @@
+/******************************************************************************
+ * labeled_tree.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "labeled_tree.h"
+#include "rmq.h"
+#include "util.h"
+
+labeled_tree* lt_create(rmMt* st, uint32_t* labels, uint32_t sigma) {
+  labeled_tree* lt = (labeled_tree*)malloc(sizeof(labeled_tree));
+  lt->st = st;
+  lt->num_nodes = st->n/2;
+  lt->bp = rank_bitmap_create(st->bit_array, st->n);
+  lt->labels = wavelet_matrix_create(labels, lt->num_nodes, sigma);
+
+  return lt;
+}
+
+void lt_free(labeled_tree* lt) {
+  rank_bitmap_free(lt->bp);
+  wavelet_matrix_free(lt->labels);
+  free(lt);
+}
+
+unsigned long lt_preorder(labeled_tree* lt, int32_t x) {
+  return rank_bitmap_rank1(lt->bp, x);
+}
+
+int32_t lt_node(labeled_tree* lt, unsigned long k) {
+  return rank_bitmap_select1(lt->bp, k+1);
+}
+
+uint32_t lt_label(labeled_tree* lt, int32_t x) {
+  return wavelet_matrix_access(lt->labels, lt_preorder(lt, x));
+}
+
+static inline int32_t node_depth(labeled_tree* lt, int32_t x) {
+  return 2*rank_bitmap_rank1(lt->bp, x+1) - x - 1;
+}
+
+// Preorder rank of the first node after the subtree of x
+static inline unsigned long subtree_end(labeled_tree* lt, int32_t x) {
+  return rank_bitmap_rank1(lt->bp, find_close(lt->st, x));
+}
+
+// First node with label c and depth d in the preorder range [lo, hi). Nodes
+// of the range must have depth >= d. Occurrences that are deeper than d are
+// skipped together with the subtree of their ancestor at depth d
+static int32_t first_at_depth(labeled_tree* lt, unsigned long lo, unsigned long hi,
+			      int32_t d, uint32_t c) {
+  unsigned long k = wavelet_matrix_rank(lt->labels, c, lo);
+
+  while(1) {
+    unsigned long pre = wavelet_matrix_select(lt->labels, c, k+1);
+    if(pre >= hi)
+      return -1;
+
+    int32_t y = lt_node(lt, pre);
+    int32_t dy = node_depth(lt, y);
+    if(dy == d)
+      return y;
+
+    // Ancestor of y at depth d. Its label is not c, otherwise it would have
+    // been found before y
+    int32_t a = bwd_search(lt->st, y, dy-d+1);
+    k = wavelet_matrix_rank(lt->labels, c, subtree_end(lt, a));
+  }
+}
+
+int32_t lt_child_by_label(labeled_tree* lt, int32_t x, uint32_t c) {
+  if(!bit_array_get_bit(lt->st->bit_array, x))
+    return -1;
+
+  return first_at_depth(lt, lt_preorder(lt, x)+1, subtree_end(lt, x),
+			node_depth(lt, x)+1, c);
+}
+
+int32_t lt_next_sibling_with_label(labeled_tree* lt, int32_t x, uint32_t c) {
+  if(!bit_array_get_bit(lt->st->bit_array, x))
+    return -1;
+
+  // Roots of a forest are siblings of each other
+  int32_t d = node_depth(lt, x);
+  unsigned long hi = (d == 1)? lt->num_nodes : subtree_end(lt, parent_t(lt->st, x));
+
+  return first_at_depth(lt, subtree_end(lt, x), hi, d, c);
+}
+
+unsigned long lt_descendant_count_with_label(labeled_tree* lt, int32_t x, uint32_t c) {
+  if(!bit_array_get_bit(lt->st->bit_array, x))
+    return 0;
+
+  return wavelet_matrix_rank(lt->labels, c, subtree_end(lt, x)) -
+    wavelet_matrix_rank(lt->labels, c, lt_preorder(lt, x)+1);
+}
+
+int32_t lt_ancestor_with_label(labeled_tree* lt, int32_t x, uint32_t c) {
+  int32_t dx = node_depth(lt, x);
+  // Occurrences of c up to k (in preorder) may enclose x
+  unsigned long k = wavelet_matrix_rank(lt->labels, c, lt_preorder(lt, x));
+
+  while(k > 0) {
+    int32_t y = lt_node(lt, wavelet_matrix_select(lt->labels, c, k));
+    if(find_close(lt->st, y) > x)
+      return y;
+
+    // An occurrence before y that encloses x encloses y too, so it is an
+    // ancestor of z = lca(y, x), whose depth is the minimum excess in [y, x]
+    int32_t dz;
+    range_min_excess(lt->st, y, x, &dz);
+    if(dz < 1) // y is in a previous tree of the forest
+      return -1;
+
+    int32_t z = bwd_search(lt->st, x, dx-dz+1);
+    k = wavelet_matrix_rank(lt->labels, c, lt_preorder(lt, z)+1);
+  }
+
+  return -1;
+}
@@ -0,0 +1,75 @@
+/******************************************************************************
+ * labeled_tree.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef LABELED_TREE_H
+#define LABELED_TREE_H
+
+#include <stdint.h>
+
+#include "succinct_tree.h"
+#include "rank_bitmap.h"
+#include "wavelet_matrix.h"
+
+// Tree with one label per node. The labels are stored in preorder in a
+// wavelet matrix, so the preorder rank of a node (rank_1 on the parentheses)
+// maps it to its label. Label-filtered navigation jumps between occurrences
+// of a label with rank/select on the wavelet matrix instead of scanning.
+// Nodes are identified by the position of their opening parenthesis
+struct labeled_tree_t {
+  rmMt* st;
+  rank_bitmap* bp; // rank/select over the parentheses of st
+  wavelet_matrix* labels;
+  unsigned long num_nodes;
+};
+
+typedef struct labeled_tree_t labeled_tree;
+
+// labels[k] is the label of the k-th node in preorder (n/2 labels in
+// [0, sigma)). The min-max tree st is not owned by the labeled tree
+labeled_tree* lt_create(rmMt* st, uint32_t* labels, uint32_t sigma);
+void lt_free(labeled_tree* lt);
+
+uint32_t lt_label(labeled_tree* lt, int32_t x);
+
+// Preorder rank of node x and node with preorder rank k (0-based)
+unsigned long lt_preorder(labeled_tree* lt, int32_t x);
+int32_t lt_node(labeled_tree* lt, unsigned long k);
+
+// First child of x with label c, or -1
+int32_t lt_child_by_label(labeled_tree* lt, int32_t x, uint32_t c);
+
+// First sibling to the right of x with label c, or -1
+int32_t lt_next_sibling_with_label(labeled_tree* lt, int32_t x, uint32_t c);
+
+// Number of descendants of x (excluding x) with label c
+unsigned long lt_descendant_count_with_label(labeled_tree* lt, int32_t x, uint32_t c);
+
+// Nearest proper ancestor of x with label c, or -1
+int32_t lt_ancestor_with_label(labeled_tree* lt, int32_t x, uint32_t c);
+
+#endif // LABELED_TREE_H
@@ -19,7 +19,7 @@ lookup_table* create_lookup_tables() {
   lookup_table* T = (lookup_table *)malloc(sizeof(lookup_table));
   
   //  int32_t x;
-  cilk_for (int32_t x = -8; x < 8; ++x) {
+  cilk_for (int32_t x = -8; x <= 8; ++x) {
     for (uint16_t w=0; w < 256; ++w) {
       uint16_t i = (x+8)<<8|w;
       T->near_fwd_pos[i] = 8;
@@ -14,14 +14,14 @@ struct _lookup_table {
   // near_fwd_pos[(x+8)<<8 | w] contains the minimal position
   // p in [0..7] where the excess value x is reached, or 8
   // if x is not reached in w.
-  uint8_t near_fwd_pos[(8-(-8))*256];
+  uint8_t near_fwd_pos[(8-(-8)+1)*256];
   
   // Given an excess value of x in [-8,8] and a 8-bit
   // word w interpreted as parentheses sequence.
   // near_bwd_pos[(x+8)<<8 | w] contains the maximal position
   // p in [0..7] where the excess value x is reached, or 8
   // if x is not reached in w.
-  uint8_t near_bwd_pos[(8-(-8))*256];
+  uint8_t near_bwd_pos[(8-(-8)+1)*256];
   
   // Given a 8-bit word w. word_sum[w] contains the
   // excess value of w.
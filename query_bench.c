@@ -0,0 +1,165 @@
+/******************************************************************************
+ * query_bench.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "succinct_tree.h"
+#include "batch_queries.h"
+#include "util.h"
+
+/*
+ * Benchmark of find_close on random opening parentheses, answered one by one
+ * and through the batch API. Output (CSV):
+ * threads,input,n,queries,method,time
+ *
+ * Cold cache: copies of the tree are made until they take 'cold' MB (by
+ * default COLD_LLC_RATIO times the last level cache), and batches of
+ * COLD_BATCH queries are issued to the copies round-robin, so each batch
+ * starts on a tree that has been evicted by the other copies. The methods
+ * are reported with the suffix '_cold'
+ */
+
+#define COLD_LLC_RATIO 4
+#define COLD_BATCH 4096
+
+static double wall_time() {
+  struct timespec t;
+  if (clock_gettime(CLOCK_MONOTONIC, &t)) {
+    fprintf(stderr, "clock_gettime failed");
+    exit(-1);
+  }
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+// Copy of st with its own bit array. A single tree is copied from the
+// leaves of st (st_extract_subtree); a forest is built again
+static rmMt* copy_tree(rmMt* st) {
+  if(find_close(st, 0) == (int32_t)st->n - 1)
+    return st_extract_subtree(st, 0);
+  return st_create(bit_array_clone(st->bit_array), st->n);
+}
+
+// Time of m queries issued to the copies in batches of COLD_BATCH
+static double cold_run(rmMt** copies, unsigned long num_copies, int interleaved,
+		       const int32_t* pos, unsigned long m, int32_t* out) {
+  double time = wall_time();
+  for(unsigned long first = 0, c = 0; first < m; first += COLD_BATCH, c++) {
+    rmMt* st = copies[c % num_copies];
+    unsigned long len = (m - first < COLD_BATCH) ? m - first : COLD_BATCH;
+    if(interleaved)
+      find_close_batch_interleaved(st, pos + first, len, out + first);
+    else
+      cilk_for(unsigned long q = first; q < first + len; q++)
+	out[q] = find_close(st, pos[q]);
+  }
+  return wall_time() - time;
+}
+
+int main(int argc, char** argv) {
+
+  if(argc < 2) {
+    fprintf(stderr, "Usage: %s <input parentheses sequence> [number of queries] [cold cache MB (0: none)]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  long n;
+  unsigned long m = (argc > 2) ? atol(argv[2]) : 1000000;
+  long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  unsigned long cold = (argc > 3) ? atol(argv[3]) << 20 :
+    COLD_LLC_RATIO*(unsigned long)(llc > 0 ? llc : 32L << 20);
+
+  BIT_ARRAY *B = parentheses_to_bits(argv[1], &n);
+  rmMt *st = st_create(B, n);
+
+  int32_t* pos = (int32_t*)malloc(m*sizeof(int32_t));
+  int32_t* expected = (int32_t*)malloc(m*sizeof(int32_t));
+  int32_t* out = (int32_t*)malloc(m*sizeof(int32_t));
+
+  srand(1);
+  for(unsigned long q = 0; q < m; ) {
+    int32_t i = ((unsigned long)rand()*RAND_MAX + rand()) % n;
+    if(bit_array_get_bit(B, i))
+      pos[q++] = i;
+  }
+
+  double time = wall_time();
+  cilk_for(unsigned long q = 0; q < m; q++)
+    expected[q] = find_close(st, pos[q]);
+  time = wall_time() - time;
+  printf("%d,%s,%lu,%lu,find_close,%lf\n", threads, argv[1], n, m, time);
+
+  time = wall_time();
+  find_close_batch(st, pos, m, out);
+  time = wall_time() - time;
+  for(unsigned long q = 0; q < m; q++)
+    if(out[q] != expected[q]) {
+      fprintf(stderr, "Error: find_close_batch(%d) = %d (expected %d)\n", pos[q], out[q], expected[q]);
+      exit(EXIT_FAILURE);
+    }
+  printf("%d,%s,%lu,%lu,find_close_batch,%lf\n", threads, argv[1], n, m, time);
+
+  time = wall_time();
+  find_close_batch_interleaved(st, pos, m, out);
+  time = wall_time() - time;
+  for(unsigned long q = 0; q < m; q++)
+    if(out[q] != expected[q]) {
+      fprintf(stderr, "Error: find_close_batch_interleaved(%d) = %d (expected %d)\n", pos[q], out[q], expected[q]);
+      exit(EXIT_FAILURE);
+    }
+  printf("%d,%s,%lu,%lu,find_close_batch_interleaved,%lf\n", threads, argv[1], n, m, time);
+
+  if(cold > 0) {
+    unsigned long num_copies = (cold + size_rmMt(st) - 1)/size_rmMt(st);
+    rmMt** copies = (rmMt**)malloc(num_copies*sizeof(rmMt*));
+    for(unsigned long c = 0; c < num_copies; c++)
+      copies[c] = copy_tree(st);
+
+    const char* names[2] = {"find_close_cold", "find_close_batch_interleaved_cold"};
+    for(int interleaved = 0; interleaved < 2; interleaved++) {
+      time = cold_run(copies, num_copies, interleaved, pos, m, out);
+      for(unsigned long q = 0; q < m; q++)
+	if(out[q] != expected[q]) {
+	  fprintf(stderr, "Error: %s(%d) = %d (expected %d)\n", names[interleaved], pos[q], out[q], expected[q]);
+	  exit(EXIT_FAILURE);
+	}
+      printf("%d,%s,%lu,%lu,%s,%lf\n", threads, argv[1], n, m, names[interleaved], time);
+    }
+
+    for(unsigned long c = 0; c < num_copies; c++) {
+      bit_array_free(copies[c]->bit_array);
+      st_free(copies[c]);
+    }
+    free(copies);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+/******************************************************************************
+ * query_log.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "query_log.h"
+
+const char* ql_op_names[QL_NUM_OPS] = {
+  "find_close", "find_open", "fwd_search", "bwd_search", "match", "sum",
+  "rank_0", "rank_1", "select_0", "select_1", "parent", "depth",
+  "first_child", "next_sibling", "is_leaf", "level_next", "level_prev",
+  "level_lmost", "level_rmost"
+};
+
+/*
+ * Capture. The buffers of the threads are kept in a list, so they can be
+ * flushed by query_log_stop, and reused by later logs
+ */
+
+struct ql_buffer {
+  uint32_t thread;
+  uint32_t count;
+  ql_record records[QL_BUFFER];
+  struct ql_buffer* next;
+};
+
+int ql_active = 0;
+__thread int ql_nested = 0;
+
+static __thread struct ql_buffer* buffer = NULL;
+static struct ql_buffer* buffers = NULL;
+static uint32_t num_buffers = 0;
+static FILE* log_fp = NULL;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// With log_lock held
+static void flush_buffer(struct ql_buffer* b) {
+  if(b->count == 0)
+    return;
+  fwrite(&b->thread, sizeof(uint32_t), 1, log_fp);
+  fwrite(&b->count, sizeof(uint32_t), 1, log_fp);
+  fwrite(b->records, sizeof(ql_record), b->count, log_fp);
+  b->count = 0;
+}
+
+void ql_append(enum ql_op op, int32_t pos, int32_t arg, int32_t result,
+	       uint64_t latency) {
+  struct ql_buffer* b = buffer;
+  if(b == NULL) {
+    b = (struct ql_buffer*)malloc(sizeof(struct ql_buffer));
+    b->count = 0;
+    pthread_mutex_lock(&log_lock);
+    b->thread = num_buffers++;
+    b->next = buffers;
+    buffers = b;
+    pthread_mutex_unlock(&log_lock);
+    buffer = b;
+  }
+
+  ql_record* r = &b->records[b->count++];
+  r->pos = pos;
+  r->arg = arg;
+  r->result = result;
+  r->op_latency = ((uint32_t)op << QL_LATENCY_BITS) |
+    (uint32_t)(latency < QL_LATENCY_MAX ? latency : QL_LATENCY_MAX);
+
+  if(b->count == QL_BUFFER) {
+    pthread_mutex_lock(&log_lock);
+    if(log_fp)
+      flush_buffer(b);
+    b->count = 0;
+    pthread_mutex_unlock(&log_lock);
+  }
+}
+
+int query_log_start(const char* fn) {
+  pthread_mutex_lock(&log_lock);
+  if(log_fp != NULL) {
+    pthread_mutex_unlock(&log_lock);
+    return -1;
+  }
+
+  log_fp = fopen(fn, "wb");
+  if(log_fp == NULL) {
+    pthread_mutex_unlock(&log_lock);
+    return -1;
+  }
+
+  uint32_t version = QL_VERSION;
+  fwrite(QL_MAGIC, 1, 4, log_fp);
+  fwrite(&version, sizeof(uint32_t), 1, log_fp);
+
+  // Records of a previous log that were not flushed are dropped
+  for(struct ql_buffer* b = buffers; b; b = b->next)
+    b->count = 0;
+  pthread_mutex_unlock(&log_lock);
+
+  __atomic_store_n(&ql_active, 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+int query_log_stop() {
+  __atomic_store_n(&ql_active, 0, __ATOMIC_RELEASE);
+
+  pthread_mutex_lock(&log_lock);
+  if(log_fp == NULL) {
+    pthread_mutex_unlock(&log_lock);
+    return -1;
+  }
+  for(struct ql_buffer* b = buffers; b; b = b->next)
+    flush_buffer(b);
+  int err = fclose(log_fp);
+  log_fp = NULL;
+  pthread_mutex_unlock(&log_lock);
+
+  return err == 0? 0 : -1;
+}
+
+/*
+ * Replay
+ */
+
+int query_log_read(const char* fn, ql_log* log) {
+  FILE* fp = fopen(fn, "rb");
+  if(fp == NULL)
+    return -1;
+
+  char magic[4];
+  uint32_t version;
+  if(fread(magic, 1, 4, fp) != 4 || memcmp(magic, QL_MAGIC, 4) != 0 ||
+     fread(&version, sizeof(uint32_t), 1, fp) != 1 || version != QL_VERSION) {
+    fclose(fp);
+    return -1;
+  }
+
+  unsigned long* cap = NULL;
+  log->num_threads = 0;
+  log->len = NULL;
+  log->records = NULL;
+
+  uint32_t header[2]; // Thread id and number of records of a block
+  while(fread(header, sizeof(uint32_t), 2, fp) == 2) {
+    uint32_t t = header[0], count = header[1];
+    if(t >= log->num_threads) {
+      log->len = (unsigned long*)realloc(log->len, (t+1)*sizeof(unsigned long));
+      log->records = (ql_record**)realloc(log->records, (t+1)*sizeof(ql_record*));
+      cap = (unsigned long*)realloc(cap, (t+1)*sizeof(unsigned long));
+      for(uint32_t u = log->num_threads; u <= t; u++) {
+	log->len[u] = cap[u] = 0;
+	log->records[u] = NULL;
+      }
+      log->num_threads = t+1;
+    }
+
+    if(log->len[t] + count > cap[t]) {
+      cap[t] = 2*cap[t] + count;
+      log->records[t] = (ql_record*)realloc(log->records[t], cap[t]*sizeof(ql_record));
+    }
+    int bad = fread(log->records[t] + log->len[t], sizeof(ql_record), count, fp) != count;
+    // Operations index the per-operation tables of the replay
+    for(uint32_t k = 0; k < count && !bad; k++)
+      bad = ql_op_of(&log->records[t][log->len[t] + k]) >= QL_NUM_OPS;
+    if(bad) {
+      free(cap);
+      query_log_free(log);
+      fclose(fp);
+      return -1;
+    }
+    log->len[t] += count;
+  }
+
+  free(cap);
+  fclose(fp);
+  return 0;
+}
+
+void query_log_free(ql_log* log) {
+  for(unsigned int t = 0; t < log->num_threads; t++)
+    free(log->records[t]);
+  free(log->records);
+  free(log->len);
+  log->num_threads = 0;
+  log->len = NULL;
+  log->records = NULL;
+}
+
+int32_t query_log_issue(rmMt* st, const ql_record* r) {
+  int32_t i = r->pos;
+  int op = ql_op_of(r);
+
+  // A log may come from a larger sequence. Depths (level_lmost and
+  // level_rmost) are checked by the operations, and sum(-1) = 0
+  if(op == QL_SELECT_0 || op == QL_SELECT_1) {
+    if(i < 1 || i > (int64_t)st->n/2)
+      return QL_OUT_OF_RANGE;
+  }
+  else if(op != QL_LEVEL_LMOST && op != QL_LEVEL_RMOST &&
+	  (i < (op == QL_SUM ? -1 : 0) || i >= (int64_t)st->n))
+    return QL_OUT_OF_RANGE;
+
+  switch(op) {
+  case QL_FIND_CLOSE: return find_close(st, i);
+  case QL_FIND_OPEN: return find_open(st, i);
+  case QL_FWD_SEARCH: return fwd_search(st, i, r->arg);
+  case QL_BWD_SEARCH: return bwd_search(st, i, r->arg);
+  case QL_MATCH: return match(st, i);
+  case QL_SUM: return sum(st, i);
+  case QL_RANK_0: return rank_0(st, i);
+  case QL_RANK_1: return rank_1(st, i);
+  case QL_SELECT_0: return select_0(st, i);
+  case QL_SELECT_1: return select_1(st, i);
+  case QL_PARENT: return parent_t(st, i);
+  case QL_DEPTH: return depth(st, i);
+  case QL_FIRST_CHILD: return first_child(st, i);
+  case QL_NEXT_SIBLING: return next_sibling(st, i);
+  case QL_IS_LEAF: return is_leaf_t(st, i);
+  case QL_LEVEL_NEXT: return level_next(st, i);
+  case QL_LEVEL_PREV: return level_prev(st, i);
+  case QL_LEVEL_LMOST: return level_lmost(st, i);
+  case QL_LEVEL_RMOST: return level_rmost(st, i);
+  default: return -1;
+  }
+}
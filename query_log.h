@@ -0,0 +1,144 @@
+/******************************************************************************
+ * query_log.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef QUERY_LOG_H
+#define QUERY_LOG_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "succinct_tree.h"
+
+// Capture of the navigation calls (succinct_tree.h). If compiled with
+// -DQUERY_LOG, each call made between query_log_start and query_log_stop is
+// recorded with its arguments, result and latency. Calls made by another
+// logged call (find_close -> fwd_search -> sum...) are not recorded, and the
+// other modules (batch kernels, tries...) are recorded as the navigation
+// calls that they make. Each thread fills its own buffer of QL_BUFFER
+// records, which is appended to the log as a block when it is full, so
+// threads only synchronize once per block. If the environment variable
+// ST_QUERY_LOG is set, the log is started before the first construction and
+// stopped at exit
+
+enum ql_op {
+  QL_FIND_CLOSE, QL_FIND_OPEN, QL_FWD_SEARCH, QL_BWD_SEARCH, QL_MATCH, QL_SUM,
+  QL_RANK_0, QL_RANK_1, QL_SELECT_0, QL_SELECT_1, QL_PARENT, QL_DEPTH,
+  QL_FIRST_CHILD, QL_NEXT_SIBLING, QL_IS_LEAF, QL_LEVEL_NEXT, QL_LEVEL_PREV,
+  QL_LEVEL_LMOST, QL_LEVEL_RMOST, QL_NUM_OPS
+};
+
+extern const char* ql_op_names[QL_NUM_OPS];
+
+// 16 bytes per call. The operation is stored in the high bits of the
+// latency, which saturates at 2^QL_LATENCY_BITS-1 ns (~134 ms)
+#define QL_LATENCY_BITS 27
+#define QL_LATENCY_MAX ((1U << QL_LATENCY_BITS) - 1)
+
+struct ql_record_t {
+  int32_t pos; // Position (or depth for level_lmost/level_rmost)
+  int32_t arg; // d of fwd_search/bwd_search, 0 otherwise
+  int32_t result;
+  uint32_t op_latency;
+};
+
+typedef struct ql_record_t ql_record;
+
+#define ql_op_of(r) ((r)->op_latency >> QL_LATENCY_BITS)
+#define ql_latency_of(r) ((r)->op_latency & QL_LATENCY_MAX)
+
+#define QL_BUFFER 4096 // Records per block
+
+// Log file: QL_MAGIC, QL_VERSION (uint32_t), and then blocks of one thread:
+// thread id (uint32_t), number of records (uint32_t) and the records
+#define QL_MAGIC "STQL"
+#define QL_VERSION 1
+
+// They return 0 on success and -1 if the file cannot be opened or a log is
+// already running. No logged call may be running during query_log_stop
+int query_log_start(const char* fn);
+int query_log_stop();
+
+// Calls of a log, grouped by the thread that made them, in order
+struct ql_log_t {
+  unsigned int num_threads;
+  unsigned long* len;
+  ql_record** records;
+};
+
+typedef struct ql_log_t ql_log;
+
+// It returns 0 on success and -1 if the file is not a valid log (also if a
+// record has an unknown operation)
+int query_log_read(const char* fn, ql_log* log);
+void query_log_free(ql_log* log);
+
+// It issues the call of r against st and returns its result, or
+// QL_OUT_OF_RANGE without issuing it if its position (rank for select_0 and
+// select_1) is out of the range of st
+#define QL_OUT_OF_RANGE INT32_MIN
+int32_t query_log_issue(rmMt* st, const ql_record* r);
+
+static inline uint64_t ql_now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+}
+
+#ifdef QUERY_LOG
+
+extern int ql_active;
+extern __thread int ql_nested;
+
+void ql_append(enum ql_op op, int32_t pos, int32_t arg, int32_t result,
+	       uint64_t latency);
+
+// Start of a logged call. It returns 0 if the call is not recorded
+static inline uint64_t ql_begin() {
+  if(ql_nested || !__atomic_load_n(&ql_active, __ATOMIC_RELAXED))
+    return 0;
+  ql_nested = 1;
+  return ql_now();
+}
+
+static inline void ql_end(uint64_t start, enum ql_op op, int32_t pos,
+			  int32_t arg, int32_t result) {
+  if(start) {
+    uint64_t latency = ql_now() - start;
+    ql_nested = 0;
+    ql_append(op, pos, arg, result, latency);
+  }
+}
+
+#define QL_BEGIN() uint64_t ql_start_ = ql_begin()
+#define QL_END(op, pos, arg, result) ql_end(ql_start_, op, pos, arg, result)
+#else
+#define QL_BEGIN()
+#define QL_END(op, pos, arg, result)
+#endif
+
+#endif // QUERY_LOG_H
@@ -0,0 +1,147 @@
+/******************************************************************************
+ * rank_bitmap.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+
+#include "rank_bitmap.h"
+#include "util.h"
+#include "basic.h"
+
+#define WORDS_PER_BLOCK (RANK_BLOCK/(sizeof(word_t)*8))
+
+rank_bitmap* rank_bitmap_create(BIT_ARRAY* B, unsigned long n) {
+  rank_bitmap* rb = (rank_bitmap*)malloc(sizeof(rank_bitmap));
+  rb->bits = B;
+  rb->n = n;
+  rb->num_blocks = (n + RANK_BLOCK - 1) >> LOG_RANK_BLOCK;
+  rb->samples = (uint32_t*)malloc((rb->num_blocks+1)*sizeof(uint32_t));
+
+  unsigned long num_words = (n + (word_size) - 1)/(word_size);
+
+  // Ones of each block
+  cilk_for(unsigned long b = 0; b < rb->num_blocks; b++) {
+    unsigned long ul = min((b+1)*WORDS_PER_BLOCK, num_words);
+    uint32_t count = 0;
+    for(unsigned long w = b*WORDS_PER_BLOCK; w < ul; w++)
+      count += __builtin_popcount(B->words[w]);
+    rb->samples[b+1] = count;
+  }
+
+  // Exclusive prefix sum
+  rb->samples[0] = 0;
+  for(unsigned long b = 1; b <= rb->num_blocks; b++)
+    rb->samples[b] += rb->samples[b-1];
+  rb->ones = rb->samples[rb->num_blocks];
+
+  return rb;
+}
+
+void rank_bitmap_free(rank_bitmap* rb) {
+  free(rb->samples);
+  free(rb);
+}
+
+unsigned long rank_bitmap_rank1(rank_bitmap* rb, unsigned long i) {
+  if(i >= rb->n)
+    return rb->ones;
+
+  unsigned long r = rb->samples[i >> LOG_RANK_BLOCK];
+  unsigned long w = (i >> LOG_RANK_BLOCK)*WORDS_PER_BLOCK;
+
+  for(; w < i/(word_size); w++)
+    r += __builtin_popcount(rb->bits->words[w]);
+  if(i%(word_size))
+    r += __builtin_popcount(rb->bits->words[w] & ((1U << (i%(word_size))) - 1));
+
+  return r;
+}
+
+unsigned long rank_bitmap_rank0(rank_bitmap* rb, unsigned long i) {
+  if(i > rb->n)
+    i = rb->n;
+  return i - rank_bitmap_rank1(rb, i);
+}
+
+// Position of the k-th one of the word x (k >= 1)
+static inline unsigned int word_select(word_t x, unsigned int k) {
+  while(--k)
+    x &= x - 1;
+  return __builtin_ctz(x);
+}
+
+unsigned long rank_bitmap_select1(rank_bitmap* rb, unsigned long k) {
+  if(k == 0 || k > rb->ones)
+    return rb->n;
+
+  // Last block with less than k ones before it
+  unsigned long lo = 0, hi = rb->num_blocks - 1;
+  while(lo < hi) {
+    unsigned long mid = (lo + hi + 1)/2;
+    if(rb->samples[mid] < k)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  k -= rb->samples[lo];
+  unsigned long w = lo*WORDS_PER_BLOCK;
+  for(;; w++) {
+    unsigned int c = __builtin_popcount(rb->bits->words[w]);
+    if(c >= k)
+      break;
+    k -= c;
+  }
+
+  return w*(word_size) + word_select(rb->bits->words[w], k);
+}
+
+unsigned long rank_bitmap_select0(rank_bitmap* rb, unsigned long k) {
+  if(k == 0 || k > rb->n - rb->ones)
+    return rb->n;
+
+  unsigned long lo = 0, hi = rb->num_blocks - 1;
+  while(lo < hi) {
+    unsigned long mid = (lo + hi + 1)/2;
+    if((mid << LOG_RANK_BLOCK) - rb->samples[mid] < k)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  k -= (lo << LOG_RANK_BLOCK) - rb->samples[lo];
+  unsigned long w = lo*WORDS_PER_BLOCK;
+  for(;; w++) {
+    unsigned int c = (word_size) - __builtin_popcount(rb->bits->words[w]);
+    if(c >= k)
+      break;
+    k -= c;
+  }
+
+  // Bits beyond n are zero, but k <= number of zeros in [0, n)
+  return w*(word_size) + word_select(~rb->bits->words[w], k);
+}
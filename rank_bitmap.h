@@ -0,0 +1,64 @@
+/******************************************************************************
+ * rank_bitmap.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef RANK_BITMAP_H
+#define RANK_BITMAP_H
+
+#include <stdint.h>
+
+#include "bit_array.h"
+
+// Rank/select support over a bit array. The number of ones before each block
+// of RANK_BLOCK bits is sampled; rank counts inside a block with popcount and
+// select does a binary search over the samples
+#define RANK_BLOCK 256
+#define LOG_RANK_BLOCK 8
+
+struct rank_bitmap_t {
+  BIT_ARRAY* bits; // Not owned by the rank_bitmap
+  unsigned long n;
+  unsigned long num_blocks;
+  uint32_t* samples; // samples[b] = number of ones in [0, b*RANK_BLOCK)
+  unsigned long ones;
+};
+
+typedef struct rank_bitmap_t rank_bitmap;
+
+// The samples are computed in parallel
+rank_bitmap* rank_bitmap_create(BIT_ARRAY* B, unsigned long n);
+void rank_bitmap_free(rank_bitmap* rb);
+
+// Number of ones (zeros) in [0, i)
+unsigned long rank_bitmap_rank1(rank_bitmap* rb, unsigned long i);
+unsigned long rank_bitmap_rank0(rank_bitmap* rb, unsigned long i);
+
+// Position of the k-th one (zero), k >= 1. It returns n if there is no such bit
+unsigned long rank_bitmap_select1(rank_bitmap* rb, unsigned long k);
+unsigned long rank_bitmap_select0(rank_bitmap* rb, unsigned long k);
+
+#endif // RANK_BITMAP_H
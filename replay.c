@@ -0,0 +1,214 @@
+/******************************************************************************
+ * replay.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "succinct_tree.h"
+#include "query_log.h"
+#include "util.h"
+
+/*
+ * Replay of a query log (query_log.h) against the min-max tree of a
+ * parentheses sequence. Modes:
+ * - original: one thread per thread of the log, each issuing its calls in the
+ *   original order (the concurrency of the capture)
+ * - max: all the calls split among all the Cilk workers
+ * Mismatches count the calls whose result differs from the logged one (the
+ * log was captured on another sequence), and the calls out of the range of
+ * the sequence, which are not issued. Latencies are in ns. Output (CSV):
+ * mode,input,op,calls,mismatches,mean,p50,p90,p99,p999,max,logged_p50,logged_p99
+ */
+
+struct replay {
+  rmMt* st;
+  const ql_record* records;
+  unsigned long len;
+  uint32_t* latency;
+  int32_t* result;
+};
+
+static void replay_range(rmMt* st, const ql_record* records, unsigned long len,
+			 uint32_t* latency, int32_t* result) {
+  for(unsigned long q = 0; q < len; q++) {
+    uint64_t start = ql_now();
+    result[q] = query_log_issue(st, &records[q]);
+    uint64_t time = ql_now() - start;
+    latency[q] = (time < QL_LATENCY_MAX) ? time : QL_LATENCY_MAX;
+  }
+}
+
+static void* replay_thread(void* arg) {
+  struct replay* r = (struct replay*)arg;
+  replay_range(r->st, r->records, r->len, r->latency, r->result);
+  return NULL;
+}
+
+static int cmp_uint32(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+// Percentile p (in [0,1]) of the sorted values v[0..n-1]
+static uint32_t percentile(const uint32_t* v, unsigned long n, double p) {
+  unsigned long k = (unsigned long)(p*n);
+  return v[(k < n) ? k : n-1];
+}
+
+int main(int argc, char** argv) {
+
+  if(argc < 3) {
+    fprintf(stderr, "Usage: %s <input parentheses sequence> <query log> [original|max]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  const char* mode = (argc > 3) ? argv[3] : "original";
+  if(strcmp(mode, "original") && strcmp(mode, "max")) {
+    fprintf(stderr, "Error: Unknown mode %s\n", mode);
+    exit(EXIT_FAILURE);
+  }
+
+  ql_log log;
+  if(query_log_read(argv[2], &log) != 0) {
+    fprintf(stderr, "Error: Cannot read the query log %s\n", argv[2]);
+    exit(EXIT_FAILURE);
+  }
+
+  long n;
+  BIT_ARRAY *B = parentheses_to_bits(argv[1], &n);
+  rmMt *st = st_create(B, n);
+
+  // The calls of all the threads, one after the other
+  unsigned int num_threads = log.num_threads;
+  unsigned long m = 0;
+  unsigned long* first = (unsigned long*)malloc((num_threads+1)*sizeof(unsigned long));
+  for(unsigned int t = 0; t < num_threads; t++) {
+    first[t] = m;
+    m += log.len[t];
+  }
+  first[num_threads] = m;
+
+  ql_record* records = (ql_record*)malloc(m*sizeof(ql_record));
+  for(unsigned int t = 0; t < num_threads; t++)
+    memcpy(records + first[t], log.records[t], log.len[t]*sizeof(ql_record));
+  query_log_free(&log);
+
+  uint32_t* latency = (uint32_t*)malloc(m*sizeof(uint32_t));
+  int32_t* result = (int32_t*)malloc(m*sizeof(int32_t));
+
+  if(!strcmp(mode, "original")) {
+    pthread_t* tids = (pthread_t*)malloc(num_threads*sizeof(pthread_t));
+    struct replay* args = (struct replay*)malloc(num_threads*sizeof(struct replay));
+    for(unsigned int t = 0; t < num_threads; t++) {
+      struct replay r = {st, records + first[t], first[t+1] - first[t],
+			 latency + first[t], result + first[t]};
+      args[t] = r;
+      pthread_create(&tids[t], NULL, replay_thread, &args[t]);
+    }
+    for(unsigned int t = 0; t < num_threads; t++)
+      pthread_join(tids[t], NULL);
+    free(tids);
+    free(args);
+  }
+  else {
+    unsigned long parts = 16*threads;
+    unsigned long per_part = (m + parts - 1)/parts;
+    cilk_for(unsigned long part = 0; part < parts; part++) {
+      unsigned long lo = part*per_part;
+      if(lo < m) {
+	unsigned long len = (m - lo < per_part) ? m - lo : per_part;
+	replay_range(st, records + lo, len, latency + lo, result + lo);
+      }
+    }
+  }
+
+  /*
+   * Latency distributions per operation. The last row (op 'all') covers every
+   * call
+   */
+  unsigned long count[QL_NUM_OPS+1], offset[QL_NUM_OPS+2];
+  memset(count, 0, sizeof(count));
+  for(unsigned long q = 0; q < m; q++)
+    count[ql_op_of(&records[q])]++;
+  count[QL_NUM_OPS] = m;
+  offset[0] = 0;
+  for(int op = 0; op < QL_NUM_OPS; op++)
+    offset[op+1] = offset[op] + count[op];
+
+  // Latencies grouped by operation, followed by all of them (from offset[QL_NUM_OPS] = m)
+  uint32_t* replayed = (uint32_t*)malloc(2*m*sizeof(uint32_t));
+  uint32_t* logged = (uint32_t*)malloc(2*m*sizeof(uint32_t));
+  unsigned long mismatches[QL_NUM_OPS+1];
+  memset(mismatches, 0, sizeof(mismatches));
+  unsigned long next[QL_NUM_OPS];
+  memcpy(next, offset, sizeof(next));
+  for(unsigned long q = 0; q < m; q++) {
+    int op = ql_op_of(&records[q]);
+    unsigned long k = next[op]++;
+    replayed[k] = replayed[m + q] = latency[q];
+    logged[k] = logged[m + q] = ql_latency_of(&records[q]);
+    if(result[q] != records[q].result) {
+      mismatches[op]++;
+      mismatches[QL_NUM_OPS]++;
+    }
+  }
+
+  printf("mode,input,op,calls,mismatches,mean,p50,p90,p99,p999,max,logged_p50,logged_p99\n");
+  for(int op = 0; op <= QL_NUM_OPS; op++) {
+    unsigned long c = count[op];
+    if(c == 0)
+      continue;
+    uint32_t* v = replayed + offset[op];
+    uint32_t* w = logged + offset[op];
+    qsort(v, c, sizeof(uint32_t), cmp_uint32);
+    qsort(w, c, sizeof(uint32_t), cmp_uint32);
+    double mean = 0;
+    for(unsigned long k = 0; k < c; k++)
+      mean += v[k];
+    mean /= c;
+
+    printf("%s,%s,%s,%lu,%lu,%.1lf,%u,%u,%u,%u,%u,%u,%u\n", mode, argv[1],
+	   (op < QL_NUM_OPS) ? ql_op_names[op] : "all", c, mismatches[op], mean,
+	   percentile(v, c, 0.5), percentile(v, c, 0.9), percentile(v, c, 0.99),
+	   percentile(v, c, 0.999), v[c-1], percentile(w, c, 0.5),
+	   percentile(w, c, 0.99));
+  }
+
+  free(replayed);
+  free(logged);
+  free(latency);
+  free(result);
+  free(records);
+  free(first);
+  st_free(st);
+  bit_array_free(B);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,423 @@
+/******************************************************************************
+ * rle_bp.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rle_bp.h"
+#include "util.h"
+#include "basic.h"
+
+// Words of the BP per parallel task when the runs are computed
+#define RUN_SEGMENT 4096
+
+// Position of a run inside its block (decoded), with the excess and the
+// number of ones before it
+struct run_ref {
+  uint64_t block;
+  uint64_t r, count;
+  int64_t start;
+  int64_t excess;
+  int64_t ones;
+  uint32_t runs[RLE_BLOCK];
+};
+
+// Blocks start at even runs, so the parity of r is that of the run
+#define IS_OPEN(r) (((r) & 1) == 0)
+#define DELTA(ref) (IS_OPEN((ref)->r)? (int64_t)(ref)->runs[(ref)->r] : -(int64_t)(ref)->runs[(ref)->r])
+
+// Gamma code of x >= 1: L = floor(log2 x) zeros, a one and the L low bits of
+// x. At most 63 bits, since runs are below 2^32
+static inline uint64_t gamma_bits(uint32_t x) {
+  return 2*(31 - __builtin_clz(x)) + 1;
+}
+
+static inline void write_gamma(uint64_t* codes, uint64_t pos, uint32_t x) {
+  int l = 31 - __builtin_clz(x);
+  uint64_t code = ((uint64_t)(x & ((1U << l) - 1)) << (l + 1)) | ((uint64_t)1 << l);
+  uint64_t w = pos/64, off = pos%64;
+  // Blocks are encoded in parallel and may share their first and last words
+  __sync_fetch_and_or(&codes[w], code << off);
+  if(off + 2*l + 1 > 64)
+    __sync_fetch_and_or(&codes[w+1], code >> (64 - off));
+}
+
+// The codes are followed by a zero word, so the window never reads past them
+static inline uint32_t read_gamma(const uint64_t* codes, uint64_t* pos) {
+  uint64_t w = *pos/64, off = *pos%64;
+  uint64_t x = codes[w] >> off;
+  if(off > 0)
+    x |= codes[w+1] << (64 - off);
+  int l = __builtin_ctzll(x);
+  *pos += 2*l + 1;
+  return ((uint32_t)1 << l) | (uint32_t)((x >> (l + 1)) & (((uint64_t)1 << l) - 1));
+}
+
+static void load_block(rle_bp* bp, struct run_ref* ref, uint64_t b) {
+  ref->block = b;
+  ref->r = 0;
+  ref->count = min((b+1)*RLE_BLOCK, bp->num_runs) - b*RLE_BLOCK;
+  ref->start = bp->starts[b];
+  ref->excess = bp->excess[b];
+  ref->ones = bp->ones[b];
+  uint64_t pos = bp->offsets[b];
+  for(uint64_t k = 0; k < ref->count; k++)
+    ref->runs[k] = read_gamma(bp->codes, &pos);
+}
+
+static void free_summaries(rle_bp* bp) {
+  free(bp->offsets);
+  free(bp->starts);
+  free(bp->excess);
+  free(bp->ones);
+  free(bp->mins);
+}
+
+// Summaries of the blocks and gamma codes of the runs. NULL if the result is
+// larger than the uncompressed BP
+static rle_bp* build(const uint32_t* runs, uint64_t num_runs) {
+  rle_bp* bp = (rle_bp*)malloc(sizeof(rle_bp));
+  bp->num_runs = num_runs;
+  bp->num_blocks = (bp->num_runs + RLE_BLOCK - 1)/RLE_BLOCK;
+  bp->offsets = (uint64_t*)malloc((bp->num_blocks+1)*sizeof(uint64_t));
+  bp->starts = (int64_t*)malloc((bp->num_blocks+1)*sizeof(int64_t));
+  bp->excess = (int64_t*)malloc((bp->num_blocks+1)*sizeof(int64_t));
+  bp->ones = (int64_t*)malloc((bp->num_blocks+1)*sizeof(int64_t));
+  int64_t* local_mins = (int64_t*)malloc(bp->num_blocks*sizeof(int64_t));
+
+  // Code bits, length, excess, ones and minimum excess (relative) of each block
+  cilk_for(uint64_t b = 0; b < bp->num_blocks; b++) {
+    uint64_t ul = min((b+1)*RLE_BLOCK, bp->num_runs);
+    uint64_t bits = 0;
+    int64_t len = 0, e = 0, ones = 0, m = INT64_MAX;
+    for(uint64_t r = b*RLE_BLOCK; r < ul; r++) {
+      bits += gamma_bits(runs[r]);
+      len += runs[r];
+      if(IS_OPEN(r)) {
+	m = min(m, e + 1);
+	ones += runs[r];
+	e += runs[r];
+      }
+      else {
+	e -= runs[r];
+	m = min(m, e);
+      }
+    }
+    bp->offsets[b] = bits;
+    bp->starts[b] = len;
+    bp->excess[b] = e;
+    bp->ones[b] = ones;
+    local_mins[b] = m;
+  }
+
+  bp->offsets[bp->num_blocks] =
+    parallel_prefix_sum((unsigned long*)bp->offsets, bp->num_blocks);
+  // Signed excesses wrap around like two's complement in the prefix sum
+  bp->n = bp->starts[bp->num_blocks] =
+    parallel_prefix_sum((unsigned long*)bp->starts, bp->num_blocks);
+  bp->excess[bp->num_blocks] =
+    parallel_prefix_sum((unsigned long*)bp->excess, bp->num_blocks);
+  bp->ones[bp->num_blocks] =
+    parallel_prefix_sum((unsigned long*)bp->ones, bp->num_blocks);
+
+  bp->leaves = 1;
+  while(bp->leaves < bp->num_blocks)
+    bp->leaves *= 2;
+  bp->mins = NULL;
+  bp->codes = NULL;
+
+  if(size_rle_bp(bp) > (uint64_t)(bp->n + 7)/8) {
+    free(local_mins);
+    free_summaries(bp);
+    free(bp);
+    return NULL;
+  }
+
+  bp->mins = (int64_t*)malloc((2*bp->leaves-1)*sizeof(int64_t));
+  cilk_for(uint64_t b = 0; b < bp->leaves; b++)
+    bp->mins[bp->leaves-1+b] = b < bp->num_blocks? bp->excess[b] + local_mins[b] : INT64_MAX;
+  for(uint64_t width = bp->leaves/2; width > 0; width /= 2) {
+    cilk_for(uint64_t v = width-1; v < 2*width-1; v++)
+      bp->mins[v] = min(bp->mins[2*v+1], bp->mins[2*v+2]);
+  }
+
+  bp->codes = (uint64_t*)calloc(bp->offsets[bp->num_blocks]/64 + 2, sizeof(uint64_t));
+  cilk_for(uint64_t b = 0; b < bp->num_blocks; b++) {
+    uint64_t ul = min((b+1)*RLE_BLOCK, bp->num_runs);
+    uint64_t pos = bp->offsets[b];
+    for(uint64_t r = b*RLE_BLOCK; r < ul; r++) {
+      write_gamma(bp->codes, pos, runs[r]);
+      pos += gamma_bits(runs[r]);
+    }
+  }
+
+  free(local_mins);
+
+  return bp;
+}
+
+rle_bp* rle_bp_create_runs(const uint32_t* runs, uint64_t num_runs) {
+  return build(runs, num_runs);
+}
+
+// A run starts at p if p = 0 or the parenthesis at p differs from the one at
+// p-1. The starts of a word are its bits that differ from the bit before
+static inline word_t run_starts(BIT_ARRAY* B, int64_t n, uint64_t w) {
+  word_t x = B->words[w];
+  word_t prev = w > 0? B->words[w-1] >> ((word_size) - 1) : (~x & 1);
+  word_t d = x ^ ((x << 1) | prev);
+  uint64_t valid = n - w*(word_size);
+  if(valid < (word_size))
+    d &= ((word_t)1 << valid) - 1;
+  return d;
+}
+
+rle_bp* rle_bp_create(BIT_ARRAY* B, int64_t n) {
+  if(n == 0 || !bit_array_get_bit(B, 0)) {
+    fprintf(stderr, "Error: The BP must start with an open parenthesis\n");
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t num_words = (n + (word_size) - 1)/(word_size);
+  uint64_t num_segments = (num_words + RUN_SEGMENT - 1)/RUN_SEGMENT;
+  unsigned long* counts = (unsigned long*)malloc(num_segments*sizeof(unsigned long));
+
+  // Runs starting in each segment of words
+  cilk_for(uint64_t seg = 0; seg < num_segments; seg++) {
+    uint64_t ul = min((seg+1)*RUN_SEGMENT, num_words);
+    unsigned long c = 0;
+    for(uint64_t w = seg*RUN_SEGMENT; w < ul; w++)
+      c += __builtin_popcount(run_starts(B, n, w));
+    counts[seg] = c;
+  }
+  uint64_t num_runs = parallel_prefix_sum(counts, num_segments);
+
+  // Positions of the starts, then lengths of the runs
+  int64_t* starts = (int64_t*)malloc((num_runs+1)*sizeof(int64_t));
+  cilk_for(uint64_t seg = 0; seg < num_segments; seg++) {
+    uint64_t ul = min((seg+1)*RUN_SEGMENT, num_words);
+    unsigned long k = counts[seg];
+    for(uint64_t w = seg*RUN_SEGMENT; w < ul; w++) {
+      word_t d = run_starts(B, n, w);
+      while(d) {
+	starts[k++] = w*(word_size) + __builtin_ctz(d);
+	d &= d - 1;
+      }
+    }
+  }
+  starts[num_runs] = n;
+
+  uint32_t* runs = (uint32_t*)malloc(num_runs*sizeof(uint32_t));
+  cilk_for(uint64_t r = 0; r < num_runs; r++)
+    runs[r] = starts[r+1] - starts[r];
+  rle_bp* bp = build(runs, num_runs);
+
+  free(runs);
+  free(starts);
+  free(counts);
+
+  return bp;
+}
+
+void rle_bp_free(rle_bp* bp) {
+  free(bp->codes);
+  free_summaries(bp);
+  free(bp);
+}
+
+uint64_t size_rle_bp(rle_bp* bp) {
+  return sizeof(rle_bp) + (bp->offsets[bp->num_blocks]/64 + 2)*sizeof(uint64_t) +
+    4*(bp->num_blocks+1)*sizeof(int64_t) + (2*bp->leaves-1)*sizeof(int64_t);
+}
+
+// Run that contains position i (0 <= i < n)
+static void locate(rle_bp* bp, int64_t i, struct run_ref* ref) {
+  uint64_t lo = 0, hi = bp->num_blocks; // Last block with starts[b] <= i
+  while(hi - lo > 1) {
+    uint64_t mid = (lo + hi)/2;
+    if(bp->starts[mid] <= i)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  load_block(bp, ref, lo);
+  while(ref->start + ref->runs[ref->r] <= i) {
+    ref->start += ref->runs[ref->r];
+    ref->excess += DELTA(ref);
+    if(IS_OPEN(ref->r))
+      ref->ones += ref->runs[ref->r];
+    ref->r++;
+  }
+}
+
+int rle_bp_access(rle_bp* bp, int64_t i) {
+  struct run_ref ref;
+  locate(bp, i, &ref);
+  return IS_OPEN(ref.r);
+}
+
+int64_t rle_bp_rank_1(rle_bp* bp, int64_t i) {
+  struct run_ref ref;
+  locate(bp, i, &ref);
+  return IS_OPEN(ref.r)? ref.ones + (i - ref.start + 1) : ref.ones;
+}
+
+/*
+ * Searches. The excess changes by one at each position, so the first (last)
+ * position with excess <= t has excess exactly t. Inside a run the excess is
+ * monotone: E(start+k) = excess+k+1 in a run of '(' and excess-k-1 in a run
+ * of ')'
+ */
+
+// First block >= from with minimum <= t, or -1
+static int64_t next_block(rle_bp* bp, uint64_t v, uint64_t lo, uint64_t hi,
+			  uint64_t from, int64_t t) {
+  if(hi <= from || bp->mins[v] > t)
+    return -1;
+  if(hi - lo == 1)
+    return lo;
+
+  uint64_t mid = (lo + hi)/2;
+  int64_t b = next_block(bp, 2*v+1, lo, mid, from, t);
+  return b >= 0? b : next_block(bp, 2*v+2, mid, hi, from, t);
+}
+
+// Last block < to with minimum <= t, or -1
+static int64_t prev_block(rle_bp* bp, uint64_t v, uint64_t lo, uint64_t hi,
+			  uint64_t to, int64_t t) {
+  if(lo >= to || bp->mins[v] > t)
+    return -1;
+  if(hi - lo == 1)
+    return lo;
+
+  uint64_t mid = (lo + hi)/2;
+  int64_t b = prev_block(bp, 2*v+2, mid, hi, to, t);
+  return b >= 0? b : prev_block(bp, 2*v+1, lo, mid, to, t);
+}
+
+// First position >= from in the run with excess <= t, or -1
+static inline int64_t run_first(struct run_ref* ref, int64_t from, int64_t t) {
+  int64_t k = max(from - ref->start, 0);
+  if(IS_OPEN(ref->r))
+    return ref->excess + k + 1 <= t? ref->start + k : -1;
+
+  k = max(k, ref->excess - 1 - t);
+  return k < ref->runs[ref->r]? ref->start + k : -1;
+}
+
+// Last position < to in the run with excess <= t, or -1
+static inline int64_t run_last(struct run_ref* ref, int64_t to, int64_t t) {
+  int64_t k = min(to - ref->start, (int64_t)ref->runs[ref->r]) - 1;
+  if(k < 0)
+    return -1;
+  if(IS_OPEN(ref->r)) {
+    k = min(k, t - ref->excess - 1);
+    return k >= 0? ref->start + k : -1;
+  }
+
+  return ref->excess - k - 1 <= t? ref->start + k : -1;
+}
+
+// First j > i with E(j) <= t, or n
+static int64_t fwd_le(rle_bp* bp, int64_t i, int64_t t) {
+  struct run_ref ref;
+  locate(bp, i, &ref);
+
+  for(;;) {
+    for(; ref.r < ref.count; ref.r++) {
+      int64_t j = run_first(&ref, i+1, t);
+      if(j >= 0)
+	return j;
+      ref.start += ref.runs[ref.r];
+      ref.excess += DELTA(&ref);
+    }
+
+    int64_t b = next_block(bp, 0, 0, bp->leaves, ref.block+1, t);
+    if(b < 0)
+      return bp->n;
+    load_block(bp, &ref, b);
+  }
+}
+
+// Last p < i with E(p) <= t, or -1 (E(-1) = 0)
+static int64_t bwd_le(rle_bp* bp, int64_t i, int64_t t) {
+  if(i == 0)
+    return -1;
+
+  struct run_ref ref;
+  locate(bp, i-1, &ref);
+
+  for(;;) {
+    for(;;) {
+      int64_t p = run_last(&ref, i, t);
+      if(p >= 0)
+	return p;
+      if(ref.r == 0)
+	break;
+      ref.r--;
+      ref.start -= ref.runs[ref.r];
+      ref.excess -= DELTA(&ref);
+    }
+
+    int64_t b = prev_block(bp, 0, 0, bp->leaves, ref.block, t);
+    if(b < 0)
+      return -1;
+    // Last run of the block, from the summaries of the next block
+    load_block(bp, &ref, b);
+    ref.r = ref.count - 1;
+    ref.start = bp->starts[b+1] - ref.runs[ref.r];
+    ref.excess = bp->excess[b+1] - DELTA(&ref);
+  }
+}
+
+static inline int64_t excess_at(rle_bp* bp, int64_t i) {
+  struct run_ref ref;
+  locate(bp, i, &ref);
+  int64_t k = i - ref.start;
+  return IS_OPEN(ref.r)? ref.excess + k + 1 : ref.excess - k - 1;
+}
+
+int64_t rle_bp_find_close(rle_bp* bp, int64_t i) {
+  return fwd_le(bp, i, excess_at(bp, i) - 1);
+}
+
+int64_t rle_bp_find_open(rle_bp* bp, int64_t i) {
+  return bwd_le(bp, i, excess_at(bp, i)) + 1;
+}
+
+int64_t rle_bp_parent(rle_bp* bp, int64_t i) {
+  if(!rle_bp_access(bp, i))
+    i = rle_bp_find_open(bp, i);
+
+  int64_t d = excess_at(bp, i);
+  if(d <= 1)
+    return -1;
+
+  return bwd_le(bp, i, d - 2) + 1;
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+ * rle_bp.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef RLE_BP_H
+#define RLE_BP_H
+
+#include <stdint.h>
+
+#include "bit_array.h"
+
+// Run-length compressed balanced parentheses. The BP is stored as the
+// lengths of its maximal runs of equal parentheses (runs of '(' at even
+// positions, since a BP starts with '('), Elias-gamma coded. Runs are grouped
+// in blocks of RLE_BLOCK runs with the offset of their first code, their
+// position, excess, number of ones and minimum excess, and the minima of the
+// blocks are indexed with a binary tree. A search decodes only the blocks it
+// visits
+#define RLE_BLOCK 64
+
+struct rle_bp_t {
+  int64_t n; // Number of parentheses
+  uint64_t num_runs;
+  uint64_t* codes; // Gamma codes of the lengths of the runs, LSB first
+  uint64_t num_blocks;
+  uint64_t* offsets; // offsets[b] = bit offset of the codes of block b (num_blocks+1)
+  int64_t* starts; // starts[b] = position of the first parenthesis of block b (num_blocks+1)
+  int64_t* excess; // excess[b] = excess before block b (num_blocks+1)
+  int64_t* ones; // ones[b] = number of '(' before block b (num_blocks+1)
+  uint64_t leaves; // Leaves of the tree of minima (power of two)
+  int64_t* mins; // Heap order, mins[leaves-1+b] = minimum excess in block b
+};
+
+typedef struct rle_bp_t rle_bp;
+
+// From the BP B of n parentheses. Runs and blocks are computed in parallel.
+// It returns NULL if the compressed BP would take more than the n/8 bytes of
+// B (short runs, as in random trees); the rmMt should be used then
+rle_bp* rle_bp_create(BIT_ARRAY* B, int64_t n);
+// From the lengths of the runs (copied), for trees that do not fit
+// uncompressed. Runs are limited to 2^32-1 parentheses. NULL as above
+rle_bp* rle_bp_create_runs(const uint32_t* runs, uint64_t num_runs);
+void rle_bp_free(rle_bp* bp);
+
+// Size in bytes of the compressed BP and its summaries
+uint64_t size_rle_bp(rle_bp* bp);
+
+// Parenthesis at position i (1 for '(')
+int rle_bp_access(rle_bp* bp, int64_t i);
+// Number of '(' in [0, i]
+int64_t rle_bp_rank_1(rle_bp* bp, int64_t i);
+int64_t rle_bp_find_close(rle_bp* bp, int64_t i);
+int64_t rle_bp_find_open(rle_bp* bp, int64_t i);
+// Opening parenthesis of the parent of the node of i, -1 for roots
+int64_t rle_bp_parent(rle_bp* bp, int64_t i);
+
+#endif // RLE_BP_H
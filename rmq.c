@@ -0,0 +1,302 @@
+/******************************************************************************
+ * rmq.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "rmq.h"
+#include "binary_trees.h"
+#include "util.h"
+#include "basic.h"
+
+// Elements processed by each task of the nearest smaller values computation
+#define RMQ_BLOCK 8192
+
+/*
+ * Construction
+ */
+
+// First block >= b with a minimum smaller than v, or num_blocks. tree is a
+// heap (root at 1) over the minimum of each block, with 'size' leaves
+static unsigned long first_block_less(int32_t* tree, unsigned long size, unsigned long num_blocks,
+				      unsigned long b, int32_t v) {
+  unsigned long node = size + b;
+
+  // Go up and right until a subtree contains a smaller value
+  while(tree[node] >= v) {
+    while(node & 1) // Right child
+      node >>= 1;
+    if(node == 0)
+      return num_blocks;
+    node++;
+  }
+
+  // Go down to the leftmost block with a smaller value
+  while(node < size) {
+    node = 2*node;
+    if(tree[node] >= v)
+      node++;
+  }
+
+  return node - size;
+}
+
+// next[j] = first k > j with A[k] < A[j], or n. Each block is solved with a
+// stack; the elements that remain in the stack (a non-decreasing sequence)
+// are solved from the top with a cursor that only moves to the right
+static unsigned long* next_smaller(int32_t* A, unsigned long n) {
+  unsigned long* next = (unsigned long*)malloc(n*sizeof(unsigned long));
+  unsigned long num_blocks = (n + RMQ_BLOCK - 1)/RMQ_BLOCK;
+  unsigned long size = 1;
+  while(size < num_blocks)
+    size *= 2;
+
+  int32_t* tree = (int32_t*)malloc(2*size*sizeof(int32_t));
+  cilk_for(unsigned long b = 0; b < size; b++) {
+    int32_t m = INT32_MAX;
+    if(b < num_blocks) {
+      unsigned long ul = min((b+1)*RMQ_BLOCK, n);
+      for(unsigned long k = b*RMQ_BLOCK; k < ul; k++)
+	m = min(m, A[k]);
+    }
+    tree[size+b] = m;
+  }
+  for(unsigned long v = size-1; v > 0; v--)
+    tree[v] = min(tree[2*v], tree[2*v+1]);
+
+  cilk_for(unsigned long b = 0; b < num_blocks; b++) {
+    unsigned long ll = b*RMQ_BLOCK, ul = min(ll + RMQ_BLOCK, n);
+    unsigned long* stack = (unsigned long*)malloc((ul-ll)*sizeof(unsigned long));
+    long top = 0;
+
+    for(unsigned long k = ll; k < ul; k++) {
+      while(top > 0 && A[stack[top-1]] > A[k])
+	next[stack[--top]] = k;
+      stack[top++] = k;
+    }
+
+    // Elements whose next smaller value is in a later block
+    unsigned long k = ul;
+    for(top--; top >= 0; top--) {
+      int32_t v = A[stack[top]];
+      while(k < n) {
+	if(k % RMQ_BLOCK == 0) { // Skip the blocks without smaller values
+	  unsigned long nb = first_block_less(tree, size, num_blocks, k/RMQ_BLOCK, v);
+	  if(nb == num_blocks) {
+	    k = n;
+	    break;
+	  }
+	  k = nb*RMQ_BLOCK;
+	}
+	if(A[k] < v)
+	  break;
+	k++;
+      }
+      next[stack[top]] = k;
+    }
+
+    free(stack);
+  }
+
+  free(tree);
+
+  return next;
+}
+
+rmq* rmq_create(int32_t* A, unsigned long n) {
+  rmq* r = (rmq*)malloc(sizeof(rmq));
+  r->n = n;
+
+  unsigned long* next = next_smaller(A, n);
+
+  // offset[i] = 1 + number of elements whose next smaller value is A[i],
+  // that is, the opening parenthesis of A[i] and the closing parentheses
+  // right before it
+  unsigned long* offset = (unsigned long*)malloc(n*sizeof(unsigned long));
+  cilk_for(unsigned long i = 0; i < n; i++)
+    offset[i] = 1;
+  cilk_for(unsigned long j = 0; j < n; j++) {
+    if(next[j] < n)
+      __sync_fetch_and_add(&offset[next[j]], 1);
+  }
+
+  // After the prefix sum, the opening parenthesis of A[i] is at offset[i+1]
+  // (the virtual root is at position 0)
+  unsigned long total = parallel_prefix_sum(offset, n);
+
+  r->bp = bit_array_create(2*n + 2);
+  bit_array_set_bit(r->bp, 0);
+  cilk_for(unsigned long i = 0; i < n; i++)
+    parallel_or_bit_array_set_bit(r->bp, (i+1 < n)? offset[i+1] : total);
+
+  free(next);
+  free(offset);
+
+  r->st = st_create(r->bp, 2*n + 2);
+  r->rb = rank_bitmap_create(r->bp, 2*n + 2);
+
+  return r;
+}
+
+void rmq_free(rmq* r) {
+  rank_bitmap_free(r->rb);
+  st_free(r->st);
+  bit_array_free(r->bp);
+  free(r);
+}
+
+/*
+ * Queries
+ */
+
+// Rightmost minimum of E(p) for p in [a, b], where e = E(a-1). (*best, *pos)
+// is replaced when the minimum is smaller or equal
+static void scan_min(BIT_ARRAY* B, int32_t a, int32_t b, int32_t e, int32_t* best, int32_t* pos) {
+  int32_t j = a;
+
+  for(; j <= b && (j&7); j++) {
+    e += 2*bit_array_get_bit(B,j)-1;
+    if(e <= *best) {
+      *best = e;
+      *pos = j;
+    }
+  }
+
+  for(; j+7 <= b; j+=8) {
+    uint8_t w = (B->words[j>>logW] >> (j&(word_size-1))) & 0xFF;
+    if(e + T->min[w] <= *best) {
+      *best = e + T->min[w];
+      *pos = j + T->min_pos_max[w];
+    }
+    e += T->word_sum[w];
+  }
+
+  for(; j <= b; j++) {
+    e += 2*bit_array_get_bit(B,j)-1;
+    if(e <= *best) {
+      *best = e;
+      *pos = j;
+    }
+  }
+}
+
+// Rightmost minimum of the chunks [l, r]: the minimum of the O(log n) nodes
+// of the min-max tree that cover the range, then down to its rightmost leaf
+static int32_t chunks_min(rmMt* st, long l, long r, int32_t* best) {
+  long lo = st->internal_nodes + l, hi = st->internal_nodes + r;
+  long lnode = -1, rnode = -1;
+
+  while(lo <= hi) {
+    if(lo == hi) {
+      ensure_node(st, lo);
+      if(lnode < 0 || st->m_prime[lo] <= st->m_prime[lnode])
+	lnode = lo;
+      break;
+    }
+    if(!is_left_child(lo)) { // Nodes of the left border, from left to right
+      ensure_node(st, lo);
+      if(lnode < 0 || st->m_prime[lo] <= st->m_prime[lnode])
+	lnode = lo;
+      lo++;
+    }
+    if(is_left_child(hi)) { // Nodes of the right border, from right to left
+      ensure_node(st, hi);
+      if(rnode < 0 || st->m_prime[hi] < st->m_prime[rnode])
+	rnode = hi;
+      hi--;
+    }
+    if(lo > hi)
+      break;
+    lo = parent(lo);
+    hi = parent(hi);
+  }
+
+  long node = lnode;
+  if(rnode >= 0 && (lnode < 0 || st->m_prime[rnode] <= st->m_prime[lnode]))
+    node = rnode;
+
+  // All the leaves below node exist, since it is inside the range
+  *best = st->m_prime[node];
+  while(!is_leaf(node, st)) {
+    if(st->m_prime[right_child(node)] == *best)
+      node = right_child(node);
+    else
+      node = left_child(node);
+  }
+
+  return node - st->internal_nodes;
+}
+
+int32_t range_min_excess(rmMt* st, int32_t x, int32_t y, int32_t* emin) {
+  long cx = x >> st->log_s, cy = y >> st->log_s;
+  int32_t best = INT32_MAX, pos = x;
+
+  if(cx == cy) {
+    scan_min(st->bit_array, x, y, sum(st, x-1), &best, &pos);
+  }
+  else {
+    scan_min(st->bit_array, x, (cx+1)*st->s - 1, sum(st, x-1), &best, &pos);
+
+    if(cx+1 <= cy-1) {
+      int32_t m;
+      long c = chunks_min(st, cx+1, cy-1, &m);
+      if(m <= best) // The chunk is scanned to find the rightmost position
+	scan_min(st->bit_array, c*st->s, (c+1)*st->s - 1, st->e_prime[c-1], &best, &pos);
+    }
+
+    scan_min(st->bit_array, cy*st->s, y, st->e_prime[cy-1], &best, &pos);
+  }
+
+  *emin = best;
+  return pos;
+}
+
+unsigned long rmq_query(rmq* r, unsigned long i, unsigned long j) {
+  if(i > j) {
+    unsigned long tmp = i;
+    i = j;
+    j = tmp;
+  }
+  if(i == j)
+    return i;
+
+  // The node of A[i] is the (i+2)-th opening parenthesis (after the root)
+  int32_t x = rank_bitmap_select1(r->rb, i+2);
+  int32_t y = rank_bitmap_select1(r->rb, j+2);
+  int32_t m;
+  int32_t z = range_min_excess(r->st, x, y, &m);
+
+  // If A[i] is an ancestor of A[j], it is the minimum. Otherwise, the
+  // minimum is the rightmost child of the lowest common ancestor that
+  // starts in (x, y]: it is right after the rightmost minimum excess
+  if(m == 2*(int32_t)rank_bitmap_rank1(r->rb, x+1) - x - 1)
+    return i;
+
+  return rank_bitmap_rank1(r->rb, z+2) - 2;
+}
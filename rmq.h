@@ -0,0 +1,62 @@
+/******************************************************************************
+ * rmq.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef RMQ_H
+#define RMQ_H
+
+#include <stdint.h>
+
+#include "succinct_tree.h"
+#include "rank_bitmap.h"
+
+// Range minimum queries over an integer array A[0..n-1] in 2n+o(n) bits. The
+// array is represented by the balanced parentheses of its 2d-min-heap: a
+// virtual root followed by the elements in order, where the parent of A[i]
+// is the previous element A[j] <= A[i]. The minimum of A[i..j] is found with
+// a range minimum excess search over the min-max tree. The array is not kept
+struct rmq_t {
+  unsigned long n;
+  BIT_ARRAY* bp; // 2n+2 parentheses
+  rmMt* st;
+  rank_bitmap* rb;
+};
+
+typedef struct rmq_t rmq;
+
+// The 2d-min-heap is computed in parallel (nearest smaller values by blocks)
+rmq* rmq_create(int32_t* A, unsigned long n);
+void rmq_free(rmq* r);
+
+// Position of the leftmost minimum of A[i..j]
+unsigned long rmq_query(rmq* r, unsigned long i, unsigned long j);
+
+// Rightmost position of the minimum excess in [x, y] of the parentheses of
+// st. The minimum is returned in *emin
+int32_t range_min_excess(rmMt* st, int32_t x, int32_t y, int32_t* emin);
+
+#endif // RMQ_H
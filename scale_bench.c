@@ -0,0 +1,234 @@
+/******************************************************************************
+ * scale_bench.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "succinct_tree.h"
+#include "bp_input.h"
+#include "util.h"
+
+/*
+ * Scaling benchmark of the construction. For each number of workers from 1
+ * to P, each method runs 'warmup' times untimed and 'repeats' times timed
+ * (wall clock). Speedup and efficiency are relative to the same method with
+ * one worker. Throughput in GB/s counts the bytes read by the method: the
+ * bit array (n/8 bytes) for the in-memory constructions and the text (n
+ * bytes) for the loaders. Output (CSV):
+ * method,workers,input,n,repeats,time_min,time_median,speedup,efficiency,parentheses_per_s,gb_per_s
+ * With each number of workers, the construction is first checked against
+ * the lazy one on trees of fewer chunks than build ranges.
+ */
+
+enum method { CREATE, CREATE_LAZY, LOAD_CREATE, PIPELINED, NUM_METHODS };
+
+static const char* method_names[NUM_METHODS] = {
+  "st_create", "st_create_lazy", "parentheses_to_bits+st_create", "bp_input_create"
+};
+
+static double wall_time() {
+  struct timespec t;
+  if (clock_gettime(CLOCK_MONOTONIC, &t)) {
+    fprintf(stderr, "clock_gettime failed");
+    exit(-1);
+  }
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+// The Cilk runtime must be stopped to change its number of workers
+static void set_workers(int p) {
+#ifndef NOPARALLEL
+  char workers[16];
+  snprintf(workers, sizeof(workers), "%d", p);
+  __cilkrts_end_cilk();
+  if(__cilkrts_set_param("nworkers", workers) != 0) {
+    fprintf(stderr, "Error: Cannot set %d workers\n", p);
+    exit(EXIT_FAILURE);
+  }
+#endif
+}
+
+// One run of a method. It returns its wall time
+static double run(enum method m, const char* fn, BIT_ARRAY* B, long n) {
+  BIT_ARRAY* loaded = NULL;
+  rmMt* st = NULL;
+  long n2;
+
+  double time = wall_time();
+  switch(m) {
+  case CREATE:
+    st = st_create(B, n);
+    break;
+  case CREATE_LAZY:
+    st = st_create_lazy(B, n);
+    break;
+  case LOAD_CREATE:
+    loaded = parentheses_to_bits(fn, &n2);
+    st = st_create(loaded, n2);
+    break;
+  case PIPELINED:
+    st = bp_input_create(fn, &loaded, &n2);
+    break;
+  default:
+    break;
+  }
+  time = wall_time() - time;
+
+  st_free(st);
+  if(loaded)
+    bit_array_free(loaded);
+
+  return time;
+}
+
+// Internal nodes of st against those of the lazy construction of B, for
+// the nodes with leaves. It returns the number of differences
+static long compare_with_lazy(rmMt* st, BIT_ARRAY* B, long n) {
+  rmMt* lazy = st_create_lazy(B, n);
+  long diffs = 0;
+  if(lazy->internal_nodes > 0)
+    lazy_build_node(lazy, 0);
+  for(unsigned int v = 0; v < st->internal_nodes; v++) {
+    unsigned int leftmost = v;
+    while(leftmost < st->internal_nodes)
+      leftmost = leftmost*st->k+1;
+    if(leftmost >= st->internal_nodes + st->num_chunks)
+      continue;
+    if(st->m_prime[v] != lazy->m_prime[v] || st->M_prime[v] != lazy->M_prime[v] ||
+       n_prime_get(st, v) != n_prime_get(lazy, v))
+      diffs++;
+  }
+  st_free(lazy);
+  return diffs;
+}
+
+// Construction check on trees of up to twice as many chunks as build
+// ranges (CHECK_TASKS per worker), where the top levels of the min-max tree
+// are built sequentially over incomplete levels
+#define CHECK_TASKS 16
+
+static void check_small_trees() {
+  st_config_init();
+  unsigned int build_tasks = st_conf.build_tasks;
+  st_conf.build_tasks = CHECK_TASKS;
+  unsigned long s = 1UL << st_conf.log_s;
+  unsigned long max_chunks = 2UL*threads*st_conf.build_tasks + 1;
+  st_builder* builder = st_builder_create();
+  srand(1);
+
+  // Downwards, so the builder reuses an arena with the data of a larger tree
+  for(unsigned long chunks = max_chunks; chunks > 0; chunks--) {
+    // A random balanced sequence that ends in the middle of its last chunk
+    long n = chunks*s - (chunks > 1 ? s/2 : 0);
+    BIT_ARRAY* B = bit_array_create(n);
+    long e = 0;
+    for(long i = 0; i < n; i++)
+      if(e == 0 || (e < n - i && rand() % 2)) {
+	bit_array_set_bit(B, i);
+	e++;
+      }
+      else
+	e--;
+
+    rmMt* st = st_create(B, n);
+    long diffs = compare_with_lazy(st, B, n);
+    st_free(st);
+    st = st_builder_build(builder, B, n);
+    diffs += compare_with_lazy(st, B, n);
+    st_free(st);
+    bit_array_free(B);
+
+    if(diffs > 0) {
+      fprintf(stderr, "Error: Wrong internal nodes in a tree of %lu chunks\n", chunks);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  st_builder_free(builder);
+  st_conf.build_tasks = build_tasks;
+}
+
+static int cmp_double(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+
+  if(argc < 2) {
+    fprintf(stderr, "Usage: %s <input parentheses sequence> [max workers] [repeats] [warmup]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  int max_workers = (argc > 2) ? atoi(argv[2]) : threads;
+  int repeats = (argc > 3) ? atoi(argv[3]) : 5;
+  int warmup = (argc > 4) ? atoi(argv[4]) : 1;
+#ifdef NOPARALLEL
+  max_workers = 1;
+#endif
+
+  long n;
+  BIT_ARRAY *B = parentheses_to_bits(argv[1], &n);
+
+  double* times = (double*)malloc(repeats*sizeof(double));
+  double base[NUM_METHODS];
+
+  printf("method,workers,input,n,repeats,time_min,time_median,speedup,efficiency,parentheses_per_s,gb_per_s\n");
+
+  for(int p = 1; p <= max_workers; p++) {
+    set_workers(p);
+    check_small_trees();
+
+    for(int m = 0; m < NUM_METHODS; m++) {
+      for(int r = 0; r < warmup; r++)
+	run(m, argv[1], B, n);
+      for(int r = 0; r < repeats; r++)
+	times[r] = run(m, argv[1], B, n);
+
+      qsort(times, repeats, sizeof(double), cmp_double);
+      double median = (repeats % 2) ? times[repeats/2] :
+	(times[repeats/2 - 1] + times[repeats/2]) / 2;
+      if(p == 1)
+	base[m] = median;
+
+      double speedup = base[m] / median;
+      double bytes = (m == LOAD_CREATE || m == PIPELINED) ? n : n / 8.0;
+      printf("%s,%d,%s,%ld,%d,%lf,%lf,%lf,%lf,%lf,%lf\n", method_names[m], p,
+	     argv[1], n, repeats, times[0], median, speedup, speedup / p,
+	     n / median, bytes / median / 1e9);
+      fflush(stdout);
+    }
+  }
+
+  free(times);
+  bit_array_free(B);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+/******************************************************************************
+ * subtree_agg.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "subtree_agg.h"
+#include "util.h"
+#include "basic.h"
+
+subtree_agg* subtree_agg_create(rmMt* st, int64_t* weights) {
+  subtree_agg* agg = (subtree_agg*)malloc(sizeof(subtree_agg));
+  agg->st = st;
+  agg->num_nodes = st->n/2;
+  agg->num_blocks = (agg->num_nodes + AGG_BLOCK - 1)/AGG_BLOCK;
+
+  agg->weights = (int64_t*)malloc(agg->num_nodes*sizeof(int64_t));
+  memcpy(agg->weights, weights, agg->num_nodes*sizeof(int64_t));
+
+  agg->levels = 1;
+  while((1UL << agg->levels) <= agg->num_blocks)
+    agg->levels++;
+
+  agg->sums = (int64_t*)malloc((agg->num_blocks+1)*sizeof(int64_t));
+  agg->mins = (int64_t**)malloc(agg->levels*sizeof(int64_t*));
+  agg->maxs = (int64_t**)malloc(agg->levels*sizeof(int64_t*));
+  for(unsigned int l = 0; l < agg->levels; l++) {
+    agg->mins[l] = (int64_t*)malloc(agg->num_blocks*sizeof(int64_t));
+    agg->maxs[l] = (int64_t*)malloc(agg->num_blocks*sizeof(int64_t));
+  }
+
+  // Sum, minimum and maximum of each block
+  cilk_for(unsigned long b = 0; b < agg->num_blocks; b++) {
+    unsigned long ul = min((b+1)*AGG_BLOCK, agg->num_nodes);
+    int64_t s = 0, mn = INT64_MAX, mx = INT64_MIN;
+    for(unsigned long k = b*AGG_BLOCK; k < ul; k++) {
+      s += weights[k];
+      mn = min(mn, weights[k]);
+      mx = max(mx, weights[k]);
+    }
+    agg->sums[b] = s;
+    agg->mins[0][b] = mn;
+    agg->maxs[0][b] = mx;
+  }
+
+  // Unsigned arithmetic wraps around like two's complement, so the prefix
+  // sums of signed weights are also right
+  agg->sums[agg->num_blocks] =
+    parallel_prefix_sum((unsigned long*)agg->sums, agg->num_blocks);
+
+  for(unsigned int l = 1; l < agg->levels; l++) {
+    unsigned long half = 1UL << (l-1);
+    cilk_for(unsigned long b = 0; b < agg->num_blocks; b++) {
+      if(b + half < agg->num_blocks) {
+	agg->mins[l][b] = min(agg->mins[l-1][b], agg->mins[l-1][b+half]);
+	agg->maxs[l][b] = max(agg->maxs[l-1][b], agg->maxs[l-1][b+half]);
+      }
+      else {
+	agg->mins[l][b] = agg->mins[l-1][b];
+	agg->maxs[l][b] = agg->maxs[l-1][b];
+      }
+    }
+  }
+
+  return agg;
+}
+
+void subtree_agg_free(subtree_agg* agg) {
+  for(unsigned int l = 0; l < agg->levels; l++) {
+    free(agg->mins[l]);
+    free(agg->maxs[l]);
+  }
+  free(agg->mins);
+  free(agg->maxs);
+  free(agg->sums);
+  free(agg->weights);
+  free(agg);
+}
+
+/*
+ * Range aggregates: partial blocks are scanned, full blocks are solved with
+ * the samples (sum) or two overlapping entries of the sparse table (min/max)
+ */
+
+static inline unsigned int floor_log2(unsigned long x) {
+  return 63 - __builtin_clzl(x);
+}
+
+int64_t agg_range_sum(subtree_agg* agg, unsigned long lo, unsigned long hi) {
+  // prefix(hi) - prefix(lo)
+  int64_t s = agg->sums[hi/AGG_BLOCK] - agg->sums[lo/AGG_BLOCK];
+  for(unsigned long k = (hi/AGG_BLOCK)*AGG_BLOCK; k < hi; k++)
+    s += agg->weights[k];
+  for(unsigned long k = (lo/AGG_BLOCK)*AGG_BLOCK; k < lo; k++)
+    s -= agg->weights[k];
+
+  return s;
+}
+
+static inline int64_t pick(int64_t a, int64_t b, int is_min) {
+  return is_min? min(a, b) : max(a, b);
+}
+
+static int64_t range_extreme(subtree_agg* agg, unsigned long lo, unsigned long hi, int is_min) {
+  int64_t** table = is_min? agg->mins : agg->maxs;
+  unsigned long bl = (lo + AGG_BLOCK - 1)/AGG_BLOCK, br = hi/AGG_BLOCK;
+  int64_t r = is_min? INT64_MAX : INT64_MIN;
+
+  if(bl >= br) { // No full block
+    for(unsigned long k = lo; k < hi; k++)
+      r = pick(r, agg->weights[k], is_min);
+    return r;
+  }
+
+  for(unsigned long k = lo; k < bl*AGG_BLOCK; k++)
+    r = pick(r, agg->weights[k], is_min);
+  for(unsigned long k = br*AGG_BLOCK; k < hi; k++)
+    r = pick(r, agg->weights[k], is_min);
+
+  unsigned int l = floor_log2(br - bl);
+  r = pick(r, table[l][bl], is_min);
+  r = pick(r, table[l][br - (1UL << l)], is_min);
+
+  return r;
+}
+
+int64_t agg_range_min(subtree_agg* agg, unsigned long lo, unsigned long hi) {
+  return range_extreme(agg, lo, hi, 1);
+}
+
+int64_t agg_range_max(subtree_agg* agg, unsigned long lo, unsigned long hi) {
+  return range_extreme(agg, lo, hi, 0);
+}
+
+/*
+ * Subtree aggregates: two ranks and one find_close give the preorder range
+ */
+
+static inline void subtree_range(subtree_agg* agg, int32_t x, unsigned long* lo, unsigned long* hi) {
+  *lo = rank_1(agg->st, x) - 1;
+  *hi = rank_1(agg->st, find_close(agg->st, x));
+}
+
+int64_t subtree_sum(subtree_agg* agg, int32_t x) {
+  unsigned long lo, hi;
+  subtree_range(agg, x, &lo, &hi);
+  return agg_range_sum(agg, lo, hi);
+}
+
+int64_t subtree_min(subtree_agg* agg, int32_t x) {
+  unsigned long lo, hi;
+  subtree_range(agg, x, &lo, &hi);
+  return agg_range_min(agg, lo, hi);
+}
+
+int64_t subtree_max(subtree_agg* agg, int32_t x) {
+  unsigned long lo, hi;
+  subtree_range(agg, x, &lo, &hi);
+  return agg_range_max(agg, lo, hi);
+}
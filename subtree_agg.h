@@ -0,0 +1,70 @@
+/******************************************************************************
+ * subtree_agg.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef SUBTREE_AGG_H
+#define SUBTREE_AGG_H
+
+#include <stdint.h>
+
+#include "succinct_tree.h"
+
+// Aggregates of node weights over subtrees. Weights are given in preorder, so
+// the subtree of node x is the range [rank_1(x)-1, rank_1(find_close(x))) of
+// preorder ranks. Prefix sums are sampled every AGG_BLOCK weights, and the
+// minimum and maximum of each block are indexed with sparse tables
+#define AGG_BLOCK 64
+
+struct subtree_agg_t {
+  rmMt* st; // Not owned
+  unsigned long num_nodes;
+  int64_t* weights;
+  unsigned long num_blocks;
+  int64_t* sums; // sums[b] = sum of the weights before block b
+  unsigned int levels;
+  int64_t** mins; // mins[l][b] = minimum of the blocks [b, b+2^l)
+  int64_t** maxs;
+};
+
+typedef struct subtree_agg_t subtree_agg;
+
+// weights[k] is the weight of the k-th node in preorder (n/2 weights). The
+// samples and tables are built in parallel
+subtree_agg* subtree_agg_create(rmMt* st, int64_t* weights);
+void subtree_agg_free(subtree_agg* agg);
+
+// Aggregates of the preorder range [lo, hi) (lo < hi)
+int64_t agg_range_sum(subtree_agg* agg, unsigned long lo, unsigned long hi);
+int64_t agg_range_min(subtree_agg* agg, unsigned long lo, unsigned long hi);
+int64_t agg_range_max(subtree_agg* agg, unsigned long lo, unsigned long hi);
+
+// Aggregates of the subtree of node x (x included)
+int64_t subtree_sum(subtree_agg* agg, int32_t x);
+int64_t subtree_min(subtree_agg* agg, int32_t x);
+int64_t subtree_max(subtree_agg* agg, int32_t x);
+
+#endif // SUBTREE_AGG_H
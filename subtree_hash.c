@@ -0,0 +1,219 @@
+/******************************************************************************
+ * subtree_hash.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+
+#include "subtree_hash.h"
+#include "util.h"
+#include "basic.h"
+
+// Symbols of the parentheses. They are not zero, so the hash of a sequence
+// depends on its leading parentheses
+#define OPEN_CODE 1
+#define CLOSE_CODE 2
+
+static inline uint64_t mul_mod(uint64_t a, uint64_t b) {
+  __uint128_t p = (__uint128_t)a*b;
+  uint64_t r = (uint64_t)(p & HASH_PRIME) + (uint64_t)(p >> 61);
+  return r >= HASH_PRIME? r - HASH_PRIME : r;
+}
+
+static inline uint64_t add_mod(uint64_t a, uint64_t b) {
+  uint64_t r = a + b;
+  return r >= HASH_PRIME? r - HASH_PRIME : r;
+}
+
+static inline uint64_t sub_mod(uint64_t a, uint64_t b) {
+  return a >= b? a - b : a + HASH_PRIME - b;
+}
+
+static uint64_t pow_mod(uint64_t b, unsigned long e) {
+  uint64_t r = 1;
+  for(; e; e >>= 1) {
+    if(e & 1)
+      r = mul_mod(r, b);
+    b = mul_mod(b, b);
+  }
+  return r;
+}
+
+static inline uint64_t push_bit(uint64_t hash, rmMt* st, int32_t p) {
+  return add_mod(mul_mod(hash, HASH_BASE),
+		 bit_array_get_bit(st->bit_array, p)? OPEN_CODE : CLOSE_CODE);
+}
+
+subtree_hash_index* subtree_hash_create(rmMt* st) {
+  subtree_hash_index* h = (subtree_hash_index*)malloc(sizeof(subtree_hash_index));
+  h->st = st;
+  h->num_nodes = st->n/2;
+  h->hashes = (uint64_t*)malloc(h->num_nodes*sizeof(uint64_t));
+
+  /*
+   * STEP 1: Hash of each chunk
+   */
+  uint64_t* prefix = (uint64_t*)malloc((st->num_chunks+1)*sizeof(uint64_t));
+  cilk_for(int32_t chunk = 0; chunk < st->num_chunks; chunk++) {
+    int32_t ul = min((chunk+1)*st->s, st->n);
+    uint64_t hash = 0;
+    for(int32_t p = chunk*st->s; p < ul; p++)
+      hash = push_bit(hash, st, p);
+    prefix[chunk+1] = hash;
+  }
+
+  /*
+   * STEP 2: Prefix hashes of the chunks. All chunks but the last one have s
+   * parentheses, so they share the factor base^s
+   */
+  uint64_t* powers = (uint64_t*)malloc((st->s+1)*sizeof(uint64_t));
+  powers[0] = 1;
+  for(int32_t p = 1; p <= st->s; p++)
+    powers[p] = mul_mod(powers[p-1], HASH_BASE);
+
+  uint64_t shift = powers[st->s];
+  prefix[0] = 0;
+  for(int32_t chunk = 1; chunk <= st->num_chunks; chunk++)
+    prefix[chunk] = add_mod(mul_mod(prefix[chunk-1], shift), prefix[chunk]);
+
+  /*
+   * STEP 3: Stack sweep of each chunk. A closing parenthesis matched inside
+   * the chunk takes its opening prefix hash from the stack. The unmatched
+   * parentheses of the chunk (counted from e' and m') are kept with their
+   * prefix hashes: H(p+1) for a closing parenthesis p and H(x) for an opening
+   * parenthesis x
+   */
+  unsigned long* num_closes = (unsigned long*)malloc((st->num_chunks+1)*sizeof(unsigned long));
+  unsigned long* num_opens = (unsigned long*)malloc((st->num_chunks+1)*sizeof(unsigned long));
+  cilk_for(int32_t chunk = 0; chunk < st->num_chunks; chunk++) {
+    long before = chunk > 0? st->e_prime[chunk-1] : 0;
+    long low = min(before, (long)st->m_prime[st->internal_nodes + chunk]);
+    num_closes[chunk] = before - low;
+    num_opens[chunk] = st->e_prime[chunk] - low;
+  }
+  unsigned long total_closes = parallel_prefix_sum(num_closes, st->num_chunks);
+  unsigned long total_opens = parallel_prefix_sum(num_opens, st->num_chunks);
+  num_closes[st->num_chunks] = total_closes;
+  num_opens[st->num_chunks] = total_opens;
+
+  int32_t* close_pos = (int32_t*)malloc((total_closes+1)*sizeof(int32_t));
+  uint64_t* close_hash = (uint64_t*)malloc((total_closes+1)*sizeof(uint64_t));
+  int32_t* open_pos = (int32_t*)malloc((total_opens+1)*sizeof(int32_t));
+  uint64_t* open_hash = (uint64_t*)malloc((total_opens+1)*sizeof(uint64_t));
+  unsigned long* open_pre = (unsigned long*)malloc((total_opens+1)*sizeof(unsigned long));
+
+  cilk_for(int32_t chunk = 0; chunk < st->num_chunks; chunk++) {
+    int32_t ll = chunk*st->s;
+    int32_t ul = min(ll + st->s, st->n);
+    unsigned long pre = ll > 0? rank_1(st, ll-1) : 0;
+    unsigned long* stack_pre = (unsigned long*)malloc(st->s*sizeof(unsigned long));
+    uint64_t* stack_hash = (uint64_t*)malloc(st->s*sizeof(uint64_t));
+    int32_t* stack_pos = (int32_t*)malloc(st->s*sizeof(int32_t));
+    int top = 0;
+    unsigned long c = num_closes[chunk];
+    uint64_t hash = prefix[chunk];
+
+    for(int32_t p = ll; p < ul; p++) {
+      if(bit_array_get_bit(st->bit_array, p)) {
+	stack_pre[top] = pre++;
+	stack_hash[top] = hash;
+	stack_pos[top] = p;
+	top++;
+	hash = push_bit(hash, st, p);
+	continue;
+      }
+
+      hash = push_bit(hash, st, p);
+      if(top == 0) {
+	close_pos[c] = p;
+	close_hash[c] = hash;
+	c++;
+	continue;
+      }
+
+      // hash[x, p] = H(p+1) - H(x)*base^(p-x+1)
+      top--;
+      h->hashes[stack_pre[top]] =
+	sub_mod(hash, mul_mod(stack_hash[top], powers[p - stack_pos[top] + 1]));
+    }
+
+    // Outermost first
+    for(int k = 0; k < top; k++) {
+      open_pos[num_opens[chunk] + k] = stack_pos[k];
+      open_hash[num_opens[chunk] + k] = stack_hash[k];
+      open_pre[num_opens[chunk] + k] = stack_pre[k];
+    }
+
+    free(stack_pre);
+    free(stack_hash);
+    free(stack_pos);
+  }
+
+  /*
+   * STEP 4: The unmatched parentheses are matched with a stack over the
+   * chunks, in order, and the pairs are hashed in parallel
+   */
+  long* match = (long*)malloc((total_closes+1)*sizeof(long));
+  long* stack = (long*)malloc((total_opens+1)*sizeof(long));
+  long top = 0;
+  for(int32_t chunk = 0; chunk < st->num_chunks; chunk++) {
+    for(unsigned long c = num_closes[chunk]; c < num_closes[chunk+1]; c++)
+      match[c] = top > 0? stack[--top] : -1; // -1 if unbalanced
+    for(unsigned long o = num_opens[chunk]; o < num_opens[chunk+1]; o++)
+      stack[top++] = o;
+  }
+
+  cilk_for(unsigned long c = 0; c < total_closes; c++) {
+    long o = match[c];
+    if(o >= 0)
+      h->hashes[open_pre[o]] =
+	sub_mod(close_hash[c], mul_mod(open_hash[o],
+				       pow_mod(HASH_BASE, close_pos[c] - open_pos[o] + 1)));
+  }
+
+  free(match);
+  free(stack);
+  free(close_pos);
+  free(close_hash);
+  free(open_pos);
+  free(open_hash);
+  free(open_pre);
+  free(num_closes);
+  free(num_opens);
+  free(prefix);
+  free(powers);
+
+  return h;
+}
+
+void subtree_hash_free(subtree_hash_index* h) {
+  free(h->hashes);
+  free(h);
+}
+
+uint64_t subtree_hash(subtree_hash_index* h, int32_t x) {
+  return h->hashes[rank_1(h->st, x) - 1];
+}
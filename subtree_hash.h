@@ -0,0 +1,60 @@
+/******************************************************************************
+ * subtree_hash.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef SUBTREE_HASH_H
+#define SUBTREE_HASH_H
+
+#include <stdint.h>
+
+#include "succinct_tree.h"
+
+// Fingerprints of subtrees: the hash of node x is the polynomial hash, modulo
+// the prime 2^61-1, of the substring [x, find_close(x)] of the BP. Two nodes
+// with isomorphic (ordered) subtrees have the same hash
+#define HASH_PRIME ((1UL << 61) - 1)
+#define HASH_BASE 1000003UL
+
+struct subtree_hash_t {
+  rmMt* st; // Not owned
+  unsigned long num_nodes;
+  uint64_t* hashes; // hashes[k] = hash of the k-th node in preorder
+};
+
+typedef struct subtree_hash_t subtree_hash_index;
+
+// The BP is hashed by chunks in parallel. Each chunk is then swept with a
+// stack, starting from the prefix hash of the chunk (fix-up as in step 2.2 of
+// st_create), and the parentheses left unmatched in their chunks are matched
+// with a stack over the chunks, carrying their prefix hashes
+subtree_hash_index* subtree_hash_create(rmMt* st);
+void subtree_hash_free(subtree_hash_index* h);
+
+// Hash of the subtree of node x
+uint64_t subtree_hash(subtree_hash_index* h, int32_t x);
+
+#endif // SUBTREE_HASH_H
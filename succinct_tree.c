@@ -33,25 +33,170 @@
 #include "bit_array.h"
 #include "util.h"
 #include "basic.h"
+#include "query_log.h"
+
+#include <string.h>
+
+lookup_table *T = NULL;
 
 /* ASSUMPTIONS:
- * - s = 256 (8 bits) (Following the sdsl/libcds implementations)
+ * - s = 256 (8 bits) by default (Following the sdsl/libcds implementations).
+ *   It can be changed by the tuning profile (st_conf.log_s)
  * - k = 2 (Min-max tree will be a binary tree)
- * - Each thread has to process at least one chunk with parentheses (Problem with n <= s)
+ * - Inputs with n <= s are stored in a single chunk (height 0, no internal nodes)
  */
 
-rmMt* init_rmMt(unsigned long n) {
+// The scans and searches over chunks are written once, with the chunk size
+// as a parameter (log_s), and always inlined. The entry points call them
+// with the literal LOG_S when the tree has the default chunk size, so that
+// version is compiled with constant shifts and a fixed trip count (and
+// unrolled); trees of a tuned profile use the run-time value
+#define SPECIALIZED static inline __attribute__((always_inline))
+#define with_log_s(st, f, ...) \
+  ((st)->log_s == LOG_S ? f(__VA_ARGS__, LOG_S) : f(__VA_ARGS__, (st)->log_s))
+
+// Integer power b^e
+static inline unsigned int ipow(unsigned int b, unsigned int e) {
+  unsigned int r = 1;
+  while(e--)
+    r *= b;
+  return r;
+}
+
+// Integer logarithm ceil(logb(x))
+static inline unsigned int ilog_ceil(unsigned int b, unsigned long x) {
+  unsigned int l = 0;
+  unsigned long p = 1;
+  while(p < x) {
+    p *= b;
+    l++;
+  }
+  return l;
+}
+
+/*
+ * Tuning profile. Lines of the form 'key=value' (see st_config); '#' starts a
+ * comment and unknown keys are ignored, so profiles of newer versions can be
+ * read.
+ */
+
+st_config st_conf = {LOG_S, 1, 1, 0, 0};
+
+static int config_state = 0; // 0: not loaded, 1: loading, 2: loaded
+
+int st_config_load(const char* fn, st_config* conf) {
+  FILE* fp = fopen(fn, "r");
+  if(fp == NULL)
+    return -1;
+
+  char line[256], key[32];
+  unsigned int value;
+  while(fgets(line, sizeof(line), fp)) {
+    if(sscanf(line, " %31[a-z_] = %u", key, &value) != 2)
+      continue;
+    if(!strcmp(key, "log_s"))
+      conf->log_s = min(max(value, ST_MIN_LOG_S), ST_MAX_LOG_S);
+    else if(!strcmp(key, "build_tasks"))
+      conf->build_tasks = max(value, 1);
+    else if(!strcmp(key, "query_tasks"))
+      conf->query_tasks = max(value, 1);
+    else if(!strcmp(key, "interleave"))
+      conf->interleave = value;
+    else if(!strcmp(key, "workers"))
+      conf->workers = value;
+  }
+
+  fclose(fp);
+  return 0;
+}
+
+int st_config_save(const char* fn, st_config* conf) {
+  FILE* fp = fopen(fn, "w");
+  if(fp == NULL)
+    return -1;
+
+  fprintf(fp, "# Profile of the succinct trees (written by st_autotune)\n");
+  fprintf(fp, "log_s=%u\n", conf->log_s);
+  fprintf(fp, "build_tasks=%u\n", conf->build_tasks);
+  fprintf(fp, "query_tasks=%u\n", conf->query_tasks);
+  fprintf(fp, "interleave=%u\n", conf->interleave);
+  fprintf(fp, "workers=%u\n", conf->workers);
+
+  return fclose(fp) == 0? 0 : -1;
+}
+
+#ifdef QUERY_LOG
+static void stop_query_log() {
+  query_log_stop();
+}
+#endif
+
+void st_config_init() {
+  if(__atomic_load_n(&config_state, __ATOMIC_ACQUIRE) == 2)
+    return;
+
+  int expected = 0;
+  if(!__atomic_compare_exchange_n(&config_state, &expected, 1, 0,
+				  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    while(__atomic_load_n(&config_state, __ATOMIC_ACQUIRE) != 2)
+      ; // Loaded by another thread
+    return;
+  }
+
+  const char* fn = getenv("ST_PROFILE");
+  if(fn == NULL)
+    fn = ST_PROFILE_FILE;
+  if(st_config_load(fn, &st_conf) == 0 && st_conf.workers > 0) {
+#ifndef NOPARALLEL
+    // It has no effect if the runtime is already running
+    char workers[16];
+    snprintf(workers, sizeof(workers), "%u", st_conf.workers);
+    __cilkrts_set_param("nworkers", workers);
+#endif
+  }
+
+#ifdef QUERY_LOG
+  const char* log = getenv("ST_QUERY_LOG");
+  if(log != NULL) {
+    if(query_log_start(log) == 0)
+      atexit(stop_query_log);
+    else
+      fprintf(stderr, "Error: Cannot write the query log %s\n", log);
+  }
+#endif
+
+  __atomic_store_n(&config_state, 2, __ATOMIC_RELEASE);
+}
+
+static rmMt* init_rmMt_s(unsigned long n, unsigned int log_s) {
   rmMt* st = (rmMt*)malloc(sizeof(rmMt));
-  st->s = 256;
+  st->log_s = log_s;
+  st->s = 1 << st->log_s;
   st->k = 2;
   st->n = n;
-  st->num_chunks = ceil((double)n/st->s);
-  st->height = ceil(log(st->num_chunks)/log(st->k)); // heigh = logk(num_chunks), Heigh of the min-max tree
-  st->internal_nodes = (pow(st->k,st->height)-1)/(st->k-1); // Number of internal nodes;
+  st->num_chunks = (n + st->s - 1) >> st->log_s;
+  st->height = ilog_ceil(st->k, st->num_chunks); // heigh = logk(num_chunks), Heigh of the min-max tree
+  st->internal_nodes = (ipow(st->k,st->height)-1)/(st->k-1); // Number of internal nodes;
+  st->ready = NULL;
+  st->arena = NULL;
 
   return st;
 }
 
+rmMt* init_rmMt(unsigned long n) {
+  st_config_init();
+  return init_rmMt_s(n, st_conf.log_s);
+}
+
+// Ranges of consecutive chunks for STEP 2.1: build_tasks per worker, and no
+// empty range
+static unsigned int num_ranges(rmMt* st) {
+  unsigned long ranges = min((unsigned long)threads*st_conf.build_tasks,
+			     (unsigned long)st->num_chunks);
+  unsigned long per_range = (st->num_chunks + ranges - 1)/ranges;
+  return (st->num_chunks + per_range - 1)/per_range;
+}
+
 void print_rmMt(rmMt* st) {
   fprintf(stderr, "Chunk size: %u\n", st->s);
   fprintf(stderr, "Arity: %u\n", st->k);
@@ -61,34 +206,230 @@ void print_rmMt(rmMt* st) {
   fprintf(stderr, "Number of internal nodes: %u\n", st->internal_nodes);
 }
 
-rmMt* st_create(BIT_ARRAY* bit_array, unsigned long n) {
-  rmMt* st = init_rmMt(n);
-  /* print_rmMt(st); */
+#define CACHE_LINE 64
+#define align_up(x) (((x) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1))
+
+// Layout of n': a node of level l covers at most s*2^(height-l)
+// parentheses, so its number of minima fits in log_s+height-l+1 bits. Each
+// level starts at a word. It returns the number of words, and sets the level
+// pointers if base is not NULL
+static size_t n_prime_layout(rmMt* st, uint32_t* base) {
+  size_t words = 0;
+  for(unsigned int l = 0; l <= st->height; l++) {
+    unsigned long nodes = l < st->height? 1UL << l : st->num_chunks;
+    st->n_width[l] = min(st->log_s + st->height - l + 1, 32);
+    if(base)
+      st->n_level[l] = base + words;
+    words += (nodes*st->n_width[l] + 31)/32;
+  }
+  return words;
+}
+
+static inline unsigned int node_level(unsigned int v) {
+  return 31 - __builtin_clz(v + 1);
+}
+
+uint32_t n_prime_get(rmMt* st, unsigned int v) {
+  unsigned int l = node_level(v);
+  return GetField(st->n_level[l], st->n_width[l], v + 1 - (1U << l));
+}
+
+// Nodes of a level share words, so they are written with CAS (several
+// threads build the leaves and the internal nodes)
+static inline void n_prime_set(rmMt* st, unsigned int v, uint32_t x) {
+  unsigned int l = node_level(v);
+  SetFieldAtomic(st->n_level[l], st->n_width[l], v + 1 - (1U << l), x);
+}
 
-  st->e_prime = (depth_t*)calloc(st->num_chunks,sizeof(depth_t));
+// Size of the arena of a min-max tree. Each array starts at a cache line
+static size_t arena_size(rmMt* st, int lazy) {
+  size_t total = st->num_chunks + st->internal_nodes;
+  size_t size = align_up(st->num_chunks*sizeof(depth_t)); // e'
+  size += 2*align_up(total*sizeof(depth_t)); // m' and M'
+  size += align_up(n_prime_layout(st, NULL)*sizeof(uint32_t)); // n'
+  if(lazy)
+    size += align_up((st->internal_nodes + 1)*sizeof(uint8_t)); // ready flags
+  return size;
+}
+
+// Plain malloc (aligned by hand) so that malloc_count also accounts for it
+static void* arena_alloc(size_t size) {
+  void* arena = malloc(size + CACHE_LINE);
+  if(arena == NULL) {
+    fprintf(stderr, "Error: Not enough memory for the min-max tree (%zu bytes)\n", size);
+    exit(EXIT_FAILURE);
+  }
+  return arena;
+}
+
+static void arena_assign(rmMt* st, char* arena, int lazy) {
+  size_t total = st->num_chunks + st->internal_nodes;
+
+  st->e_prime = (depth_t*)arena;
+  arena += align_up(st->num_chunks*sizeof(depth_t));
   // num_chunks leaves plus internal nodes
-  st->m_prime = (depth_t*)calloc(st->num_chunks + st->internal_nodes,sizeof(depth_t));
+  st->m_prime = (depth_t*)arena;
+  arena += align_up(total*sizeof(depth_t));
   // num_chunks leaves plus internal nodes
-  st->M_prime = (depth_t*)calloc(st->num_chunks + st->internal_nodes,sizeof(depth_t));  
-  st->n_prime = (int16_t*)calloc(st->num_chunks + st->internal_nodes,sizeof(int16_t));
-  st->bit_array = bit_array;
+  st->M_prime = (depth_t*)arena;
+  arena += align_up(total*sizeof(depth_t));
+  st->n_prime = (uint32_t*)arena;
+  arena += align_up(n_prime_layout(st, st->n_prime)*sizeof(uint32_t));
+
+  st->ready = NULL;
+  if(lazy) {
+    st->ready = (uint8_t*)arena;
+    memset(st->ready, 0, (st->internal_nodes + 1)*sizeof(uint8_t));
+  }
+}
+
+// The universal tables do not depend on the input, so they are computed
+// once and shared by all the min-max trees
+static void init_lookup_tables() {
+  if(__atomic_load_n(&T, __ATOMIC_ACQUIRE))
+    return;
+
+  lookup_table* tables = create_lookup_tables();
+  lookup_table* expected = NULL;
+  if(!__atomic_compare_exchange_n(&T, &expected, tables, 0, __ATOMIC_ACQ_REL,
+				  __ATOMIC_ACQUIRE))
+    free(tables); // Computed by another thread
+}
+
+// A node of the min-max tree has leaves if its leftmost leaf exists (the
+// tree is not complete, and its arrays are not zeroed)
+static inline int has_leaves(rmMt* st, unsigned int v) {
+  while(v < st->internal_nodes)
+    v = v*st->k+1;
+  return v < st->internal_nodes + st->num_chunks;
+}
+
+// STEP 2.3 of the construction: the internal nodes are computed from the
+// leaves, in parallel by subtrees below level p_level and sequentially above
+static void build_internal_nodes(rmMt* st, unsigned int num_threads) {
+  int p_level = ilog_ceil(st->k, num_threads); /* p_level = logk(num_threads), level at which each thread has at least one 
+						  subtree to process in parallel */
+  unsigned int num_subtrees = ipow(st->k,p_level); /* num_subtrees = k^p_level, number of subtrees of the min-max tree 
+						 that will be computed in parallel at level p_level.
+						 num_subtrees is O(num_threads) */
   
-  if(st->s >= n){
-    fprintf(stderr, "Error: Input size is smaller or equal than the chunk size (input size: %lu, chunk size: %u)\n", n, st->s);
+  //unsigned int subtree = 0;
+
+  uint total_chunks = st->internal_nodes + st->num_chunks;
+  cilk_for(unsigned int subtree = 0; subtree < num_subtrees; subtree++) {
+      for(int lvl = st->height-1; lvl >= p_level; lvl--){ //The current level that is being constructed.
+	//Note: The last level (leaves) is already constructed
+	unsigned int num_curr_nodes = ipow(st->k, lvl-p_level); //Number of nodes at curr_level level that belong to the subtree
+      
+      for(unsigned int node = 0; node < num_curr_nodes; node++) {
+  	unsigned int pos = (ipow(st->k,lvl)-1)/(st->k-1) + node + subtree*num_curr_nodes;// Position in the final array of 'node'.
+  									    //Note: It should be less than the offset
+  	unsigned int lchild = pos*st->k+1, rchild = (pos+1)*st->k; //Range of children of 'node' in the final array
+	
+	depth_t min = 0, max = 0; // Zero for nodes without children
+	uint32_t num_mins = 0;
+  	for(unsigned int child = lchild; (child <= rchild) && (child <
+  	total_chunks); child++) {	  
+	  if(!has_leaves(st, child))
+	    break; // Neither do the next children
+  	  if(child == lchild){// first time
+  	    min = st->m_prime[child];
+  	    max = st->M_prime[child];
+  	    num_mins = n_prime_get(st, child);
+  	  }
+  	  else {
+  	    if(st->m_prime[child] < min) {
+  	      min = st->m_prime[child];
+  	      num_mins = n_prime_get(st, child);
+	    }
+	    else if(st->m_prime[child] == min)
+	      num_mins += n_prime_get(st, child);
+	    
+  	    if(st->M_prime[child] > max)
+  	      max = st->M_prime[child];
+  	  }
+  	}
+	st->m_prime[pos] = min;
+	st->M_prime[pos] = max;
+	n_prime_set(st, pos, num_mins);
+      }
+    }
+  }
+   
+  for(int lvl=p_level-1; lvl >= 0 ; lvl--){ // O(num_threads)
+    
+    unsigned int num_curr_nodes = ipow(st->k, lvl); // Number of nodes at curr_level level that belong to the subtree
+    unsigned int node = 0, child = 0;
+    
+    for(node = 0; node < num_curr_nodes; node++) {
+      unsigned int pos = (ipow(st->k,lvl)-1)/(st->k-1) + node; // Position in the final array of 'node'
+      unsigned int lchild = pos*st->k+1, rchild = (pos+1)*st->k; // Range of children of 'node' in the final array
+      depth_t min = 0, max = 0; // Zero for nodes without children
+      uint32_t num_mins = 0;
+      for(child = lchild; child <= rchild; child++){
+	if(!has_leaves(st, child))
+	  break; // Neither do the next children
+	
+	if(child == lchild) { // first time
+	  min = st->m_prime[child];
+	  max = st->M_prime[child];
+	  num_mins = n_prime_get(st, child);
+	}
+	else {
+	  if(st->m_prime[child] < min) {
+	    min = st->m_prime[child];
+	    num_mins = n_prime_get(st, child);
+	  }
+	  else if(st->m_prime[child] == min)
+	    num_mins += n_prime_get(st, child);
+
+	  if(st->M_prime[child] > max)
+	    max = st->M_prime[child];
+	}
+      }
+      st->m_prime[pos] = min;
+      st->M_prime[pos] = max;
+      n_prime_set(st, pos, num_mins);
+    }
+  }
+}
+
+static rmMt* st_create_common(BIT_ARRAY* bit_array, unsigned long n, int lazy,
+			      st_builder* builder) {
+  rmMt* st = init_rmMt(n);
+  /* print_rmMt(st); */
+
+  if(n == 0){
+    fprintf(stderr, "Error: Empty input\n");
     exit(0);
   }
+
+  // All the arrays of the min-max tree live in a single arena. Nothing is
+  // zeroed: every entry is written during the construction
+  size_t size = arena_size(st, lazy);
+  void* arena;
+  if(builder) {
+    if(builder->capacity < size) {
+      free(builder->arena);
+      builder->arena = arena_alloc(size);
+      builder->capacity = size;
+    }
+    arena = builder->arena;
+    st->arena = NULL; // The arena belongs to the builder
+  }
+  else
+    arena = st->arena = arena_alloc(size);
+
+  arena_assign(st, (char*)align_up((uintptr_t)arena), lazy);
+  st->bit_array = bit_array;
   
   /*
    * STEP 2: Computation of arrays e', m', M' and n'
    */
-  unsigned int num_threads;
-  if(st->num_chunks < threads)
-    num_threads = st->num_chunks;
-  else
-    num_threads = threads;
+  unsigned int num_threads = num_ranges(st);
 
   // Each thread works on 'chunks_per_thread' consecutive chunks of the bit_array 
-  unsigned int chunks_per_thread = ceil((double)st->num_chunks/num_threads);
+  unsigned int chunks_per_thread = (st->num_chunks + num_threads - 1)/num_threads;
 
   /*
    * STEP 2.1: Each thread computes the prefix computation in a range of the bit array
@@ -161,7 +502,7 @@ rmMt* st_create(BIT_ARRAY* bit_array, unsigned long n) {
 	st->e_prime[thread*chunks_per_thread+chunk] = partial_excess;
 	st->m_prime[st->internal_nodes + thread*chunks_per_thread+chunk] = min;
 	st->M_prime[st->internal_nodes + thread*chunks_per_thread+chunk] = max;
-	st->n_prime[st->internal_nodes + thread*chunks_per_thread+chunk] = num_mins;
+	n_prime_set(st, st->internal_nodes + thread*chunks_per_thread+chunk, num_mins);
       }
     }
   }
@@ -208,104 +549,339 @@ rmMt* st_create(BIT_ARRAY* bit_array, unsigned long n) {
   /*
    * STEP 2.3: Completing the internal nodes of the min-max tree
    */
-      
-  int p_level = ceil(log(num_threads)/log(st->k)); /* p_level = logk(num_threads), level at which each thread has at least one 
-						  subtree to process in parallel */
-  unsigned int num_subtrees = pow(st->k,p_level); /* num_subtrees = k^p_level, number of subtrees of the min-max tree 
-						 that will be computed in parallel at level p_level.
-						 num_subtrees is O(num_threads) */
-  
-  //unsigned int subtree = 0;
 
-  uint total_chunks = st->internal_nodes + st->num_chunks;
-  cilk_for(unsigned int subtree = 0; subtree < num_subtrees; subtree++) {
-      for(int lvl = st->height-1; lvl >= p_level; lvl--){ //The current level that is being constructed.
-	//Note: The last level (leaves) is already constructed
-	unsigned int num_curr_nodes = pow(st->k, lvl-p_level); //Number of nodes at curr_level level that belong to the subtree
+  if(lazy) {
+    // Internal nodes will be computed by lazy_build_node() on first touch
+    init_lookup_tables();
+    return st;
+  }
       
-      for(unsigned int node = 0; node < num_curr_nodes; node++) {
-  	unsigned int pos = pow(st->k,lvl)-1 + node + subtree*num_curr_nodes;// Position in the final array of 'node'.
-  									    //Note: It should be less than the offset
-  	unsigned int lchild = pos*st->k+1, rchild = (pos+1)*st->k; //Range of children of 'node' in the final array
-	
-  	/* for(unsigned int child = lchild; (child <= rchild) && (child < st->num_chunks); child++) { */
-  	for(unsigned int child = lchild; (child <= rchild) && (child <
-  	total_chunks); child++) {	  
-  	  if(child == lchild){// first time
-  	    st->m_prime[pos] = st->m_prime[child];
-  	    st->M_prime[pos] = st->M_prime[child];
-  	    st->n_prime[pos] = st->n_prime[child];
-  	  }
-  	  else {
-  	    if(st->m_prime[child] < st->m_prime[pos]) {
-  	      st->m_prime[pos] = st->m_prime[child];
-  	      st->n_prime[pos] = 1;
-	    }
-	    else if(st->m_prime[child] == st->m_prime[pos])
-	      st->n_prime[pos]++;
-	    
-  	    if(st->M_prime[child] > st->M_prime[pos])
-  	      st->M_prime[pos] = st->M_prime[child];
-  	  }
-  	}
+  build_internal_nodes(st, num_threads);
+
+  /*
+   * STEP 3: Computation of all universal tables
+   */
+
+  init_lookup_tables();
+
+  return st;
+}
+
+rmMt* st_create(BIT_ARRAY* bit_array, unsigned long n) {
+  return st_create_common(bit_array, n, 0, NULL);
+}
+
+rmMt* st_create_lazy(BIT_ARRAY* bit_array, unsigned long n) {
+  return st_create_common(bit_array, n, 1, NULL);
+}
+
+rmMt* st_create_checked(BIT_ARRAY* bit_array, unsigned long n, bp_status* status) {
+  rmMt* st = st_create_common(bit_array, n, 0, NULL);
+  st_status(st, status);
+  return st;
+}
+
+#define STATUS_BLOCK 4096 // Leaves per parallel task in st_status
+#define VALIDATE_BLOCK 65536 // Bytes per parallel task in bp_validate
+
+// First position in [lo, hi) where the excess, starting with excess before
+// lo, is negative. It assumes that there is one
+static long first_negative_bit(BIT_ARRAY* B, unsigned long lo, unsigned long hi, long excess) {
+  for(unsigned long p = lo; p < hi; p++) {
+    excess += bit_array_get_bit(B, p)? 1 : -1;
+    if(excess < 0)
+      return p;
+  }
+  return -1;
+}
+
+void st_status(rmMt* st, bp_status* status) {
+  unsigned long num_blocks = (st->num_chunks + STATUS_BLOCK - 1)/STATUS_BLOCK;
+  long* firsts = (long*)malloc(num_blocks*sizeof(long));
+
+  // First leaf with a negative minimum in each block of leaves
+  cilk_for(unsigned long b = 0; b < num_blocks; b++) {
+    unsigned long ul = min((b+1)*STATUS_BLOCK, st->num_chunks);
+    firsts[b] = -1;
+    for(unsigned long chunk = b*STATUS_BLOCK; chunk < ul; chunk++)
+      if(st->m_prime[st->internal_nodes + chunk] < 0) {
+	firsts[b] = chunk;
+	break;
       }
+  }
+
+  long chunk = -1;
+  for(unsigned long b = 0; b < num_blocks && chunk < 0; b++)
+    chunk = firsts[b];
+  free(firsts);
+
+  status->first_negative = -1;
+  if(chunk >= 0)
+    status->first_negative =
+      first_negative_bit(st->bit_array, chunk*st->s, min((chunk+1)*st->s, st->n),
+			 chunk > 0? st->e_prime[chunk-1] : 0);
+  status->final_excess = st->e_prime[st->num_chunks-1];
+  status->balanced = status->first_negative < 0 && status->final_excess == 0;
+}
+
+void bp_validate(BIT_ARRAY* B, unsigned long n, bp_status* status) {
+  init_lookup_tables();
+
+  const unsigned char* bytes = (const unsigned char*)B->words;
+  unsigned long num_bytes = n/8;
+  unsigned long num_blocks = (num_bytes + VALIDATE_BLOCK - 1)/VALIDATE_BLOCK;
+  long* excess = (long*)malloc((num_blocks+1)*sizeof(long));
+  long* mins = (long*)malloc((num_blocks+1)*sizeof(long));
+
+  // Excess and minimum excess (relative) of each block of full bytes
+  cilk_for(unsigned long b = 0; b < num_blocks; b++) {
+    unsigned long ul = min((b+1)*VALIDATE_BLOCK, num_bytes);
+    long e = 0, m = 0;
+    for(unsigned long k = b*VALIDATE_BLOCK; k < ul; k++) {
+      m = min(m, e + T->min[bytes[k]]);
+      e += T->word_sum[bytes[k]];
     }
+    excess[b] = e;
+    mins[b] = m;
   }
-   
-  for(int lvl=p_level-1; lvl >= 0 ; lvl--){ // O(num_threads)
-    
-    unsigned int num_curr_nodes = pow(st->k, lvl); // Number of nodes at curr_level level that belong to the subtree
-    unsigned int node = 0, child = 0;
-    
-    for(node = 0; node < num_curr_nodes; node++) {
-      unsigned int pos = (pow(st->k,lvl)-1)/(st->k-1) + node; // Position in the final array of 'node'
-      unsigned int lchild = pos*st->k+1, rchild = (pos+1)*st->k; // Range of children of 'node' in the final array
-      for(child = lchild; child <= rchild; child++){
-	if(st->m_prime[child] == st->M_prime[child])
-	  continue;
-	
-	if(child == lchild) { // first time
-	  st->m_prime[pos] = st->m_prime[child];
-	  st->M_prime[pos] = st->M_prime[child];
-	  st->n_prime[pos] = st->n_prime[child];
-	}
-	else {
-	  if(st->m_prime[child] < st->m_prime[pos]) {
-	    st->m_prime[pos] = st->m_prime[child];
-  	    st->n_prime[pos] = 1;
-	  }
-	  else if(st->m_prime[child] == st->m_prime[pos])
-	    st->n_prime[pos]++;
 
-	  if(st->M_prime[child] > st->M_prime[pos])
-	    st->M_prime[pos] = st->M_prime[child];
-	}
+  // The bits after the last full byte are one more block
+  excess[num_blocks] = mins[num_blocks] = 0;
+  for(unsigned long p = num_bytes*8; p < n; p++) {
+    excess[num_blocks] += bit_array_get_bit(B, p)? 1 : -1;
+    mins[num_blocks] = min(mins[num_blocks], excess[num_blocks]);
+  }
+
+  long e = 0, first = -1;
+  for(unsigned long b = 0; b <= num_blocks; b++) {
+    if(first < 0 && e + mins[b] < 0) {
+      // Bytes of the block, then bits of the byte
+      unsigned long k = min(b*VALIDATE_BLOCK, num_bytes);
+      unsigned long ul = min((b+1)*VALIDATE_BLOCK, num_bytes);
+      long x = e;
+      for(; k < ul && x + T->min[bytes[k]] >= 0; k++)
+	x += T->word_sum[bytes[k]];
+      first = first_negative_bit(B, k*8, n, x);
+    }
+    e += excess[b];
+  }
+
+  free(excess);
+  free(mins);
+
+  status->first_negative = first;
+  status->final_excess = e;
+  status->balanced = first < 0 && e == 0;
+}
+
+void st_free(rmMt* st) {
+  free(st->arena); // NULL if the arena belongs to a builder
+  free(st);
+}
+
+st_builder* st_builder_create() {
+  st_builder* builder = (st_builder*)malloc(sizeof(st_builder));
+  builder->arena = NULL;
+  builder->capacity = 0;
+  return builder;
+}
+
+rmMt* st_builder_build(st_builder* builder, BIT_ARRAY* bit_array, unsigned long n) {
+  return st_create_common(bit_array, n, 0, builder);
+}
+
+void st_builder_free(st_builder* builder) {
+  free(builder->arena);
+  free(builder);
+}
+
+void st_chunk_summary(BIT_ARRAY* B, unsigned long lo, unsigned long hi,
+		      depth_t* e, depth_t* m, depth_t* M, int16_t* n) {
+  depth_t excess = 0, min = 0, max = 0;
+  int16_t num_mins = 1;
+
+  for(unsigned long symbol = lo; symbol < hi; symbol++) {
+    if(bit_array_get_bit(B, symbol) == 0)
+      --excess;
+    else
+      ++excess;
+
+    if(symbol == lo) {
+      min = max = excess;
+      num_mins = 1;
+    }
+    else {
+      if(excess < min) {
+	min = excess;
+	num_mins = 1;
       }
+      else if(excess == min)
+	num_mins++;
+
+      if(excess > max)
+	max = excess;
     }
   }
-  
-  /*
-   * STEP 3: Computation of all universal tables
-   */
 
-  T = create_lookup_tables();
+  *e = excess;
+  *m = min;
+  *M = max;
+  *n = num_mins;
+}
+
+// Leaf values of a chunk, given the excess before it
+static void scan_leaf(rmMt* st, unsigned int chunk, depth_t excess) {
+  unsigned int leaf = st->internal_nodes + chunk;
+  int16_t num_mins;
+  st_chunk_summary(st->bit_array, chunk*st->s, min((chunk+1)*st->s, st->n),
+		   &st->e_prime[chunk], &st->m_prime[leaf], &st->M_prime[leaf],
+		   &num_mins);
+  n_prime_set(st, leaf, num_mins);
+  st->e_prime[chunk] += excess;
+  st->m_prime[leaf] += excess;
+  st->M_prime[leaf] += excess;
+}
+
+rmMt* st_create_from_chunks(BIT_ARRAY* bit_array, unsigned long n,
+			    unsigned int log_s, depth_t* e, depth_t* m,
+			    depth_t* M, int16_t* num_mins) {
+  if(n == 0){
+    fprintf(stderr, "Error: Empty input\n");
+    exit(0);
+  }
+
+  rmMt* st = init_rmMt_s(n, log_s);
+  st->arena = arena_alloc(arena_size(st, 0));
+  arena_assign(st, (char*)align_up((uintptr_t)st->arena), 0);
+  st->bit_array = bit_array;
+
+  // STEP 2.2: the summaries are shifted by the excess before their chunk.
+  // It is O(n/s), so it is done sequentially
+  depth_t excess = 0;
+  for(unsigned int chunk = 0; chunk < st->num_chunks; chunk++) {
+    unsigned int leaf = st->internal_nodes + chunk;
+    st->m_prime[leaf] = m[chunk] + excess;
+    st->M_prime[leaf] = M[chunk] + excess;
+    n_prime_set(st, leaf, num_mins[chunk]);
+    excess += e[chunk];
+    st->e_prime[chunk] = excess;
+  }
+
+  build_internal_nodes(st, num_ranges(st));
+  init_lookup_tables();
 
   return st;
 }
 
-int32_t sum(rmMt* st, int32_t idx){
+rmMt* st_extract_subtree(rmMt* st, int32_t i) {
+  int32_t c = find_close(st, i);
+  unsigned long n = c - i + 1;
+  BIT_ARRAY* bit_array = bit_array_extract(st->bit_array, i, n);
+
+  // The chunks of the subtree are not chunks of st
+  if((i & (st->s - 1)) != 0)
+    return st_create(bit_array, n);
+
+  rmMt* sub = init_rmMt_s(n, st->log_s);
+  sub->arena = arena_alloc(arena_size(sub, 0));
+  arena_assign(sub, (char*)align_up((uintptr_t)sub->arena), 0);
+  sub->bit_array = bit_array;
+
+  // Every chunk but the last one is a full chunk of st: its values are
+  // shifted by the excess before the subtree
+  unsigned int first = i >> st->log_s;
+  depth_t base = first > 0? st->e_prime[first-1] : 0;
+  cilk_for(unsigned int chunk = 0; chunk < sub->num_chunks - 1; chunk++) {
+    unsigned int leaf = st->internal_nodes + first + chunk;
+    sub->e_prime[chunk] = st->e_prime[first + chunk] - base;
+    sub->m_prime[sub->internal_nodes + chunk] = st->m_prime[leaf] - base;
+    sub->M_prime[sub->internal_nodes + chunk] = st->M_prime[leaf] - base;
+    n_prime_set(sub, sub->internal_nodes + chunk, n_prime_get(st, leaf));
+  }
+
+  // The last chunk ends at find_close(i), so it is scanned again
+  unsigned int last = sub->num_chunks - 1;
+  scan_leaf(sub, last, last > 0? sub->e_prime[last-1] : 0);
+
+  build_internal_nodes(sub, num_ranges(sub));
+
+  return sub;
+}
+
+/*
+ * Lazy construction: computes the internal node pos (and, recursively, the
+ * nodes below it that were not computed yet).
+ *
+ * Nodes are published lock-free: the values of a node are written before its
+ * ready flag is set with release semantics, so any thread that observes the
+ * flag (acquire) also observes the values of the node and of all its
+ * descendants. Two threads may compute the same node at the same time; both
+ * write the same values, so the race is harmless.
+ */
+void lazy_build_node(rmMt* st, unsigned int pos) {
+  if(pos >= st->internal_nodes)
+    return; // Leaves are computed by st_create_lazy
+
+  if(__atomic_load_n(&st->ready[pos], __ATOMIC_ACQUIRE))
+    return;
+
+  unsigned int lchild = pos*st->k+1, rchild = (pos+1)*st->k; // Range of children of 'node' in the final array
+  depth_t min = 0, max = 0;
+  uint32_t num_mins = 0;
+  int first = 1;
+
+  for(unsigned int child = lchild; child <= rchild; child++) {
+    // Skip children without leaves (the min-max tree is not complete)
+    if(!has_leaves(st, child))
+      continue;
+
+    lazy_build_node(st, child);
+
+    depth_t cm = __atomic_load_n(&st->m_prime[child], __ATOMIC_RELAXED);
+    depth_t cM = __atomic_load_n(&st->M_prime[child], __ATOMIC_RELAXED);
+    uint32_t cn = n_prime_get(st, child);
+
+    if(first) {
+      min = cm;
+      max = cM;
+      num_mins = cn;
+      first = 0;
+    }
+    else {
+      if(cm < min) {
+	min = cm;
+	num_mins = cn;
+      }
+      else if(cm == min)
+	num_mins += cn;
 
+      if(cM > max)
+	max = cM;
+    }
+  }
+
+  __atomic_store_n(&st->m_prime[pos], min, __ATOMIC_RELAXED);
+  __atomic_store_n(&st->M_prime[pos], max, __ATOMIC_RELAXED);
+  n_prime_set(st, pos, num_mins);
+  __atomic_store_n(&st->ready[pos], 1, __ATOMIC_RELEASE);
+}
+
+SPECIALIZED int32_t sum_s(rmMt* st, int32_t idx, unsigned int log_s) {
+
+  // Before the unsigned comparison with n, which would catch idx < 0
+  if(idx < 0)
+    return 0;
   if(idx >= st->n)
     return -1;
   
-  int32_t chk = idx/st->s;
+  int32_t chk = idx >> log_s;
   int32_t excess = 0;
 
   // Previous chunk
   if(chk)
     excess += st->e_prime[chk-1];
   
-  int llimit = chk*st->s;
+  int llimit = chk << log_s;
   int rlimit = (idx/8)*8;
 
   word_t j=0;
@@ -325,8 +901,12 @@ int32_t sum(rmMt* st, int32_t idx){
   return excess;
 }
 
+static int32_t sum_impl(rmMt* st, int32_t idx){
+  return with_log_s(st, sum_s, st, idx);
+}
+
 int32_t check_leaf(rmMt* st, int32_t i, int32_t d) {
-  int end = (i/st->s+1)*st->s;
+  int end = ((i >> st->log_s)+1)*st->s;
   int llimit = (((i)+8)/8)*8;
   int rlimit = (end/8)*8;
   int32_t excess = d;
@@ -373,7 +953,7 @@ int32_t check_sibling(rmMt* st, int32_t i, int32_t d) {
   int llimit = i;
   int rlimit = i+st->s;
   int32_t output;
-  int32_t excess = st->e_prime[(i-1)/st->s];
+  int32_t excess = st->e_prime[(i-1) >> st->log_s];
   int32_t j = 0;
 
   for(j=llimit; j<rlimit; j+=8) {
@@ -402,7 +982,7 @@ int32_t fwd_search2(rmMt* st, int32_t i) {
     // Excess value up to the ith position 
     int32_t d = sum(st, i);
     
-    int chunk = i / st->s;
+    int chunk = i >> st->log_s;
     int32_t output;
     long j;
     
@@ -416,7 +996,7 @@ int32_t fwd_search2(rmMt* st, int32_t i) {
     // (assuming a binary tree, if i%2==0, then its right sibling is at position
     // i+1)
     
-    if(chunk%2 == 0) { // The current chunk has a right sibling
+    if(chunk%2 == 0 && chunk+1 < st->num_chunks) { // The current chunk has a right sibling
       // The answer is in the right sibling of the current node
       if(st->m_prime[chunk+1] <= d && d <= st->M_prime[chunk+1]) { 
 	output = check_sibling(st, st->s*(chunk+1), d);
@@ -432,6 +1012,7 @@ int32_t fwd_search2(rmMt* st, int32_t i) {
     while (!is_root(node)) {
       if (is_left_child(node)) { // if the node is a left child
 	node = right_sibling(node); // choose right sibling
+	ensure_node(st, node);
 	
 	if (st->m_prime[node] <= d-1 && d-1 <= st->M_prime[node])
 	  break;
@@ -458,22 +1039,24 @@ int32_t fwd_search2(rmMt* st, int32_t i) {
 }
 
 // Check a leaf from left to right
-int32_t check_leaf_r(rmMt* st, int32_t i, int32_t d) {
-  int end = (i/st->s+1)*st->s;
+// excess is the excess value at position i, target is absolute
+SPECIALIZED int32_t check_leaf_r_s(rmMt* st, int32_t i, int32_t target,
+				   int32_t excess, unsigned int log_s) {
+  int end = min(((i >> log_s)+1) << log_s, st->n); // The last chunk may be incomplete
   int llimit = (((i)+8)/8)*8;
   int rlimit = (end/8)*8;
-  int32_t excess = d;
   int32_t output;
   int32_t j = 0;
   
   for(j=i+1; j< min(end, llimit); j++){
     excess += 2*bit_array_get_bit(st->bit_array,j)-1;
-    if(excess == d-1)
+    if(excess == target)
       return j;
   }
 
+#pragma GCC unroll 4
   for(j=llimit; j<rlimit; j+=8) {
-    int32_t desired = d - 1 - excess; // desired value must belongs to the range [-8,8]
+    int32_t desired = target - excess; // desired value must belongs to the range [-8,8]
     
 #ifdef ARCH64
     int32_t sum_idx = (((st->bit_array)->words[j>>logW]) & (0xFFL<<(j&(word_size-1)))) >> (j&(word_size-1));
@@ -493,7 +1076,7 @@ int32_t check_leaf_r(rmMt* st, int32_t i, int32_t d) {
   
   for (j=max(llimit,rlimit); j < end; ++j) {
     excess += 2*bit_array_get_bit(st->bit_array,j)-1;
-    if (excess == d-1) {
+    if (excess == target) {
       return j;
     }
   }
@@ -501,14 +1084,20 @@ int32_t check_leaf_r(rmMt* st, int32_t i, int32_t d) {
   return i-1;
 }
 
+int32_t check_leaf_r(rmMt* st, int32_t i, int32_t target, int32_t excess) {
+  return with_log_s(st, check_leaf_r_s, st, i, target, excess);
+}
+
 // Check siblings from left to right
-int32_t check_sibling_r(rmMt* st, int32_t i, int32_t d) {
+SPECIALIZED int32_t check_sibling_r_s(rmMt* st, int32_t i, int32_t d,
+				      unsigned int log_s) {
   int llimit = i;
-  int rlimit = i+st->s;
+  int rlimit = i + (1 << log_s);
   int32_t output;
-  int32_t excess = st->e_prime[(i-1)/st->s];
+  int32_t excess = st->e_prime[(i-1) >> log_s];
   int32_t j = 0;
 
+#pragma GCC unroll 4
   for(j=llimit; j<rlimit; j+=8) {
     int32_t desired = d - excess; // desired value must belongs to the range [-8,8]  
     
@@ -532,38 +1121,20 @@ int32_t check_sibling_r(rmMt* st, int32_t i, int32_t d) {
   return i-1;
 }
 
-int32_t fwd_search(rmMt* st, int32_t i, int32_t d) {
-    // Excess value up to the ith position 
-    int32_t target = sum(st, i) + d - 1;
-    
-    int chunk = i / st->s;
-    int32_t output;
-    long j;
-    
-    // Case 1: Check if the chunk of i contains fwd_search(bit_array, i, target)
-    output = check_leaf_r(st, i, target);
-    if(output > i)
-      return output;
-    
-    // Case 2: The answer is not in the chunk of i, but it is in its sibling
-    // (assuming a binary tree, if i%2==0, then its right sibling is at position i+1)
-    if(chunk%2 == 0) { // The current chunk has a right sibling
-      // The answer is in the right sibling of the current node
-      if(st->m_prime[st->internal_nodes + chunk+1] <= target && target <=
-	 st->M_prime[st->internal_nodes+ chunk+1]) {
+int32_t check_sibling_r(rmMt* st, int32_t i, int32_t d) {
+  return with_log_s(st, check_sibling_r_s, st, i, d);
+}
 
-	output = check_sibling_r(st, st->s*(chunk+1), target);
-	if(output >= st->s*(chunk+1))
-	  return output;
-      }
-    }
-  
-    // Case 3: It is necessary up and then down in the min-max tree
+// Case 3 of fwd_search: starting at the leaf 'chunk', it goes up and then down
+// in the min-max tree. It returns the chunk that contains the first excess
+// value 'target' to the right of 'chunk', or -1 if there is no such chunk
+int32_t fwd_search_chunk(rmMt* st, int32_t chunk, int32_t target) {
     long node = parent(chunk + st->internal_nodes); // Initial node
     // Go up the tree
     while (!is_root(node)) {
       if (is_left_child(node)) { // if the node is a left child
 	node = right_sibling(node); // choose right sibling
+	ensure_node(st, node);
 	
 	if (st->m_prime[node] <= target && target <= st->M_prime[node])
 	  break;
@@ -578,19 +1149,57 @@ int32_t fwd_search(rmMt* st, int32_t i, int32_t d) {
 	if (!(st->m_prime[node] <= target && target <= st->M_prime[node])) {
 	  node = right_sibling(node); // choose right child == right sibling of the left child
 	  if(st->m_prime[node] > target || target > st->M_prime[node]) {
-	    return i;
+	    return -1;
 	  }
 	}
       }
       
-      chunk = node - st->internal_nodes;
+      return node - st->internal_nodes;
+    }
+    return -1;
+}
 
-      return check_sibling_r(st, st->s*chunk, target);
+SPECIALIZED int32_t fwd_search_s(rmMt* st, int32_t i, int32_t d,
+				 unsigned int log_s) {
+    // Excess value up to the ith position 
+    int32_t excess = sum_s(st, i, log_s);
+    int32_t target = excess + d - 1;
+    
+    int chunk = i >> log_s;
+    int32_t output;
+    long j;
+    
+    // Case 1: Check if the chunk of i contains fwd_search(bit_array, i, target)
+    output = check_leaf_r_s(st, i, target, excess, log_s);
+    if(output > i)
+      return output;
+    
+    // Case 2: The answer is not in the chunk of i, but it is in its sibling
+    // (assuming a binary tree, if i%2==0, then its right sibling is at position i+1)
+    if(chunk%2 == 0 && chunk+1 < st->num_chunks) { // The current chunk has a right sibling
+      // The answer is in the right sibling of the current node
+      if(st->m_prime[st->internal_nodes + chunk+1] <= target && target <=
+	 st->M_prime[st->internal_nodes+ chunk+1]) {
+
+	output = check_sibling_r_s(st, (chunk+1) << log_s, target, log_s);
+	if(output >= (chunk+1) << log_s)
+	  return output;
+      }
     }
-    return i;
+  
+    // Case 3: It is necessary up and then down in the min-max tree
+    chunk = fwd_search_chunk(st, chunk, target);
+    if(chunk < 0)
+      return i;
+
+    return check_sibling_r_s(st, chunk << log_s, target, log_s);
+}
+
+static int32_t fwd_search_impl(rmMt* st, int32_t i, int32_t d) {
+  return with_log_s(st, fwd_search_s, st, i, d);
 }
 
-int32_t find_close(rmMt* st, int32_t i){
+static int32_t find_close_impl(rmMt* st, int32_t i){
   if(bit_array_get_bit(st->bit_array,i) == 0)
     return i;
 
@@ -620,7 +1229,7 @@ int32_t semi_fwd_search(rmMt* st, int32_t i, int32_t d) {
   int32_t excess = sum(st, i);
   int32_t target = excess + d - 1;
   int32_t j = 0;
-  int chunk = i/st->s;
+  int chunk = i >> st->log_s;
 
   int begin = i+1;
   int end = (chunk+1)*st->s;
@@ -666,7 +1275,7 @@ int32_t find_close_semi(rmMt* st, int32_t i){
   return semi_fwd_search(st, i, 0);
 }
 
-int32_t rank_0(rmMt* st, int32_t i) {
+static int32_t rank_0_impl(rmMt* st, int32_t i) {
   // Excess value up to the ith position
   if(i >= st->n)
     i = st->n-1;
@@ -702,7 +1311,7 @@ int32_t semi_bwd_search(rmMt* st, int32_t i, int32_t d) {
   if(target == 0 && i == st->n-1)
     return 0;
   
-  int chunk = i/st->s;
+  int chunk = i >> st->log_s;
   int begin = i;
   int end = chunk*st->s;
 
@@ -741,154 +1350,109 @@ int32_t semi_bwd_search(rmMt* st, int32_t i, int32_t d) {
   return i;
 }
 
-// Check a leaf from right to left
-int32_t check_leaf_l(rmMt* st, int32_t i, int32_t target, int32_t excess) {
-  int rlimit = (i/8)*8;
-  int begin = (i/st->s)*st->s;
-  int llimit = ((begin+8)/8)*8;
-  if(llimit > rlimit)
-    llimit = rlimit;
-  int32_t output;
-  int32_t j = 0;
-
-  for(j=i; j >= max(rlimit, llimit); j--){
-    excess += 2*bit_array_get_bit(st->bit_array,j)-1;
-    if(excess == target) {
-      return j;
-    }
-  }
-  for(j = rlimit-8; j >= llimit; j-=8) {
-    int32_t desired = excess - target; // desired value must belongs to the range [-8,8]
-    
-#ifdef ARCH64
-    int32_t sum_idx = (((st->bit_array)->words[j>>logW]) & (0xFFL<<(j&(word_size-1)))) >> (j&(word_size-1));
-#else
-    int32_t sum_idx = (((st->bit_array)->words[j>>logW]) & (0xFF<<(j&(word_size-1)))) >> (j&(word_size-1));
-#endif
-    if (desired >= -8 && desired <= 8) {
-      uint16_t ii = (desired+8<<8) + sum_idx;
-      
-      int8_t x = T->near_bwd_pos[ii];
-      if(x < 8)
-	return j+x;
-    }
-    excess += T->word_sum[sum_idx];
-  }
+// Largest q in [lo, hi] with E(q) = target, where excess = E(hi). It
+// returns lo-1 if not found
+static int32_t scan_bwd(rmMt* st, int32_t lo, int32_t hi, int32_t target, int32_t excess) {
+  int32_t q = hi;
 
-  for (j=min(llimit,rlimit)-1; j >= begin; j--) {
-    excess += 2*bit_array_get_bit(st->bit_array,j)-1;
-    if (excess == target) {
-      return j;
-    }
+  for(; q >= lo && (q+1)%8 != 0; q--) {
+    if(excess == target)
+      return q;
+    excess -= 2*bit_array_get_bit(st->bit_array,q)-1; // E(q-1)
   }
-  
-  return i;
-}
 
-// Check a left sibling
-int32_t check_sibling_l(rmMt* st, int32_t i, int32_t excess, int32_t d) {
-  int llimit = i;
-  int rlimit = i+st->s;
-
-  int32_t e = st->e_prime[i/st->s];
-  int32_t output;
-  int32_t j = 0;
+  for(; q-7 >= lo; q-=8) {
+    if(excess == target)
+      return q;
 
-  for(j = rlimit-8; j >= llimit; j-=8) {
-    int32_t desired =  excess - d - e; // desired value must belongs to the range [-8,8]
-    
+    int32_t b = q-7; // First position of the byte
 #ifdef ARCH64
-    int32_t sum_idx = (((st->bit_array)->words[j>>logW]) & (0xFFL<<(j&(word_size-1)))) >> (j&(word_size-1));
+    int32_t sum_idx = (((st->bit_array)->words[b>>logW]) & (0xFFL<<(b&(word_size-1)))) >> (b&(word_size-1));
 #else
-    int32_t sum_idx = (((st->bit_array)->words[j>>logW]) & (0xFF<<(j&(word_size-1)))) >> (j&(word_size-1));
+    int32_t sum_idx = (((st->bit_array)->words[b>>logW]) & (0xFF<<(b&(word_size-1)))) >> (b&(word_size-1));
 #endif
+    // near_bwd_pos gives the largest p with E(b+p-1) - E(q) = desired
+    int32_t desired = target - excess; // desired value must belongs to the range [-8,8]
     if (desired >= -8 && desired <= 8) {
-      uint16_t ii = (desired+8<<8) + sum_idx;
-      
-      int8_t x = T->near_bwd_pos[ii];
-      if(x < 8)
-	return j+x;
+      int8_t p = T->near_bwd_pos[((desired+8)<<8) + sum_idx];
+      if(p >= 1 && p < 8) // p == 0 (E(b-1)) is checked with the next byte
+	return b+p-1;
     }
-    e -= T->word_sum[sum_idx];
+    excess -= T->word_sum[sum_idx]; // E(b-1)
   }
-  
-  return i-1;
-}
 
-int32_t bwd_search(rmMt* st, int32_t i, int32_t d) {
-  int32_t excess = sum(st, i);
-  int32_t target = excess + d;
+  for(; q >= lo; q--) {
+    if(excess == target)
+      return q;
+    excess -= 2*bit_array_get_bit(st->bit_array,q)-1;
+  }
 
-  int chunk = i / st->s;
-  int32_t output = i;
-  long j;
+  return lo-1;
+}
 
-  // Case 1: Check if the chunk of i contains bwd_search(bit_array, i, target)
-  output = check_leaf_l(st, i, target, excess);
-  if(output < i)
-    return output;
-  
-  // Case 2: The answer is not in the chunk of i, but it is in its sibling
-  // (assuming a binary tree, if i%2==1, then its left sibling is at position i-1)
-  if(chunk%2 == 1) { // The current chunk has a left sibling
-    // The answer is in the left sibling of the current node
-    if(st->m_prime[st->internal_nodes + chunk - 1] <= excess-d+1 && excess-d+1 <=
-       st->M_prime[st->internal_nodes + chunk - 1]) {
-      
-      output = check_sibling_l(st, st->s*(chunk-1), excess, d);
-      if(output >= st->s*(chunk-1))
-  	return output;
-    }
-  }
+// Rightmost chunk to the left of 'chunk' that contains the excess value
+// 'target', or -1
+static int32_t bwd_search_chunk(rmMt* st, int32_t chunk, int32_t target) {
+  long node = chunk + st->internal_nodes;
 
-  // Case 3: It is necessary up and then down in the min-max tree
-  long node = parent(chunk + st->internal_nodes); // Initial node
   // Go up the tree
   while (!is_root(node)) {
-    if (is_right_child(node)) { // if the node is a left child
-      node = left_sibling(node); // choose right sibling
-      
-      //      if (st->m_prime[node] <= target && target <= st->M_prime[node])
-      if (st->m_prime[node] <= excess-d && excess-d <= st->M_prime[node])
-	break;      
+    if (!is_left_child(node)) {
+      node = left_sibling(node);
+      ensure_node(st, node);
+      if (st->m_prime[node] <= target && target <= st->M_prime[node])
+	break;
     }
-    node = parent(node); // choose parent
+    node = parent(node);
   }
 
-  // Go down the tree
-  if (!is_root(node)) { // found solution for the query
-    while (!is_leaf(node, st)) {
-      node = right_child(node); // choose right child
-
-      if (!(st->m_prime[node] <= excess-d && excess-d <= st->M_prime[node])) {
-	node = left_sibling(node); // choose left child == left sibling of the	right child
-	
-	if(st->m_prime[node] > excess-d || excess-d > st->M_prime[node]) {
-	  return i;
-	}
-      }
-    }
+  if (is_root(node))
+    return -1;
 
-    chunk = node - st->internal_nodes;
+  // Go down the tree. All the leaves to the left of 'chunk' exist
+  while (!is_leaf(node, st)) {
+    node = right_child(node);
+    if (!(st->m_prime[node] <= target && target <= st->M_prime[node]))
+      node = left_sibling(node);
+  }
 
-    // Special case: if the result is at the beginning of chunk i, then,
-    // the previous condition will select the chunk i-1
-    //    if(st->e_prime[chunk] == target) { // If the last value (e') of chunk is equal
-    if(st->e_prime[chunk] == excess-d) { // If the last value (e') of chunk is equal
-    // to the target, then the answer is in the first position of the next chunk
+  return node - st->internal_nodes;
+}
 
-      return (chunk+1)*st->s;
-    }
-    
-    return check_sibling_l(st, st->s*chunk, excess, d);
-  }
-  else {// Special case: Pair of parentheses wrapping the parentheses sequence
-        //(at positions 0 and n-1)
-    if(i == st->n-1 && excess==0)
-      output = 0;
+// The excess values of a chunk are contiguous, so a chunk contains a value iff
+// it is in the range [m', M'] of the chunk
+SPECIALIZED int32_t bwd_search_s(rmMt* st, int32_t i, int32_t d,
+				 unsigned int log_s) {
+  int32_t excess = sum_s(st, i, log_s);
+  int32_t target = excess - d; // Searched value: E(j-1), with E(-1) = 0
+
+  int chunk = i >> log_s;
+  int32_t begin = chunk << log_s;
+  int32_t q;
+
+  // Case 1: The chunk of i (and the last position of the previous chunk)
+  if(i > begin) {
+    q = scan_bwd(st, begin, i-1, target, excess - (2*bit_array_get_bit(st->bit_array,i)-1));
+    if(q >= begin)
+      return q+1;
   }
+  if(((chunk > 0)? st->e_prime[chunk-1] : 0) == target)
+    return begin;
 
-  return output;
+  // Case 2 and 3: Up and then down in the min-max tree
+  chunk = bwd_search_chunk(st, chunk, target);
+  if(chunk < 0)
+    return (target == 0)? 0 : i; // E(-1) = 0
+
+  q = scan_bwd(st, chunk << log_s, ((chunk+1) << log_s) - 1, target, st->e_prime[chunk]);
+  if(q < chunk << log_s) // E(chunk*s - 1) == target
+    return chunk << log_s;
+
+  return q+1;
+}
+
+static int32_t bwd_search_impl(rmMt* st, int32_t i, int32_t d) {
+  return with_log_s(st, bwd_search_s, st, i, d);
 }
 
 int32_t find_open_naive(rmMt* st, int32_t i){
@@ -898,7 +1462,7 @@ int32_t find_open_naive(rmMt* st, int32_t i){
   return naive_bwd_search(st, i, 0);  
 }
 
-int32_t find_open(rmMt* st, int32_t i){
+static int32_t find_open_impl(rmMt* st, int32_t i){
   if(bit_array_get_bit(st->bit_array,i) == 1)
     return i;
 
@@ -912,7 +1476,7 @@ int32_t find_open_semi(rmMt* st, int32_t i){
   return semi_bwd_search(st, i, 0);  
 }
 
-int32_t rank_1(rmMt* st, int32_t i) {
+static int32_t rank_1_impl(rmMt* st, int32_t i) {
     // Excess value up to the ith position 
   if(i >= st->n)
     i = st->n-1;
@@ -926,7 +1490,7 @@ int32_t check_chunk(rmMt* st, int32_t i, int32_t d) {
   int llimit = i;
   int rlimit = i+st->s;
   int32_t output;
-  int32_t excess = st->e_prime[(i-1)/st->s];
+  int32_t excess = st->e_prime[(i-1) >> st->log_s];
   int32_t j = 0;
 
   for(j=llimit; j<rlimit; j+=8) {
@@ -952,7 +1516,7 @@ int32_t check_chunk(rmMt* st, int32_t i, int32_t d) {
 }
 
 // ToDo: Implement it more efficiently
-int32_t select_0(rmMt* st, int32_t i){
+static int32_t select_0_impl(rmMt* st, int32_t i){
 
   int32_t j = 0;
 
@@ -962,6 +1526,7 @@ int32_t select_0(rmMt* st, int32_t i){
   // Note: The answer is not beyond the position 2*i-1+depth_max, where
   // depth_max is the maximal depth (excess) of the input tree
   int32_t llimit = 2*i-1;
+  ensure_node(st, 0);
   int32_t rlimit = llimit + st->M_prime[0];
   int32_t d = 0;
 
@@ -975,7 +1540,7 @@ int32_t select_0(rmMt* st, int32_t i){
 }
 
 // ToDo: Implement it more efficiently
-int32_t select_1(rmMt* st, int32_t i){
+static int32_t select_1_impl(rmMt* st, int32_t i){
   int32_t j = 0;
 
   // Note: The answer is in the range [0,2*i-1] not beyond the position 2*i-1
@@ -994,7 +1559,7 @@ int32_t select_1(rmMt* st, int32_t i){
 }
 
 
-int32_t match(rmMt* st, int32_t i) {
+static int32_t match_impl(rmMt* st, int32_t i) {
   if(bit_array_get_bit(st->bit_array,i))
     return find_close(st, i);
   else
@@ -1016,18 +1581,18 @@ int32_t match_semi(rmMt* st, int32_t i) {
 }
 
 
-int32_t parent_t(rmMt* st, int32_t i) {
+static int32_t parent_t_impl(rmMt* st, int32_t i) {
   if(!bit_array_get_bit(st->bit_array,i))
     i = find_open(st, i);
   
   return bwd_search(st, i, 2);
 }
 
-int32_t depth(rmMt* st, int32_t i) {
+static int32_t depth_impl(rmMt* st, int32_t i) {
   return 2*rank_1(st, i)-i-1;
 }
 
-int32_t first_child(rmMt* st, int32_t i) {
+static int32_t first_child_impl(rmMt* st, int32_t i) {
   if(i >= st->n-1)
     return -1;
 
@@ -1040,7 +1605,7 @@ int32_t first_child(rmMt* st, int32_t i) {
     return -1;
 }
 
-int32_t next_sibling(rmMt* st, int32_t i) {
+static int32_t next_sibling_impl(rmMt* st, int32_t i) {
   if(i >= st->n-1)
     return -1;
   
@@ -1055,7 +1620,7 @@ int32_t next_sibling(rmMt* st, int32_t i) {
     return -1;
 }
 
-int32_t is_leaf_t(rmMt* st, int32_t i) {
+static int32_t is_leaf_t_impl(rmMt* st, int32_t i) {
   if(i >= st->n-1)
     return 0;
 
@@ -1068,11 +1633,223 @@ int32_t is_leaf_t(rmMt* st, int32_t i) {
   return 0;
 }
 
+/*
+ * Level operations. Nodes at depth d are the opening parentheses that reach
+ * excess d, so the next (previous) one is found with a forward (backward)
+ * search for an excess value, guided by m' and M'
+ */
+
+static int32_t level_next_impl(rmMt* st, int32_t i) {
+  if(!bit_array_get_bit(st->bit_array,i))
+    return -1;
+
+  // First position after the subtree of i with the excess of i
+  int32_t c = find_close(st, i);
+  int32_t j = fwd_search(st, c, 2);
+
+  return (j > c)? j : -1;
+}
+
+static int32_t level_prev_impl(rmMt* st, int32_t i) {
+  if(!bit_array_get_bit(st->bit_array,i) || i == 0)
+    return -1;
+
+  // The previous node closes right before i
+  if(!bit_array_get_bit(st->bit_array,i-1))
+    return find_open(st, i-1);
+
+  // Last closing parenthesis before i that returns from the depth of i (i-1
+  // is the parent of i, so the answer is before i-1)
+  int32_t j = bwd_search(st, i-1, -1);
+  if(j >= i-1)
+    return -1;
+
+  return find_open(st, j);
+}
+
+static int32_t level_lmost_impl(rmMt* st, int32_t d) {
+  if(d < 1)
+    return -1;
+  if(d == 1)
+    return 0;
+
+  int32_t j = fwd_search(st, 0, d);
+
+  return (j > 0)? j : -1;
+}
+
+static int32_t level_rmost_impl(rmMt* st, int32_t d) {
+  if(d < 1)
+    return -1;
+  if(d == 1)
+    return find_open(st, st->n-1);
+
+  // Last closing parenthesis that returns from depth d
+  int32_t j = bwd_search(st, st->n-1, -d);
+  if(j >= st->n-1)
+    return -1;
+
+  return find_open(st, j);
+}
+
+void level_iterator_init(level_iterator* it, rmMt* st, int32_t d) {
+  it->st = st;
+  it->node = level_lmost(st, d);
+}
+
+int32_t level_iterator_next(level_iterator* it) {
+  int32_t node = it->node;
+
+  if(node >= 0)
+    it->node = level_next(it->st, node);
+
+  return node;
+}
+
+/*
+ * Entry points of the navigation operations. They record the call if the
+ * query log is enabled (query_log.h); otherwise the implementations above
+ * are inlined
+ */
+
+int32_t find_close(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = find_close_impl(st, i);
+  QL_END(QL_FIND_CLOSE, i, 0, r);
+  return r;
+}
+
+int32_t find_open(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = find_open_impl(st, i);
+  QL_END(QL_FIND_OPEN, i, 0, r);
+  return r;
+}
+
+int32_t fwd_search(rmMt* st, int32_t i, int32_t d) {
+  QL_BEGIN();
+  int32_t r = fwd_search_impl(st, i, d);
+  QL_END(QL_FWD_SEARCH, i, d, r);
+  return r;
+}
+
+int32_t bwd_search(rmMt* st, int32_t i, int32_t d) {
+  QL_BEGIN();
+  int32_t r = bwd_search_impl(st, i, d);
+  QL_END(QL_BWD_SEARCH, i, d, r);
+  return r;
+}
+
+int32_t match(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = match_impl(st, i);
+  QL_END(QL_MATCH, i, 0, r);
+  return r;
+}
+
+int32_t sum(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = sum_impl(st, i);
+  QL_END(QL_SUM, i, 0, r);
+  return r;
+}
+
+int32_t rank_0(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = rank_0_impl(st, i);
+  QL_END(QL_RANK_0, i, 0, r);
+  return r;
+}
+
+int32_t rank_1(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = rank_1_impl(st, i);
+  QL_END(QL_RANK_1, i, 0, r);
+  return r;
+}
+
+int32_t select_0(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = select_0_impl(st, i);
+  QL_END(QL_SELECT_0, i, 0, r);
+  return r;
+}
+
+int32_t select_1(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = select_1_impl(st, i);
+  QL_END(QL_SELECT_1, i, 0, r);
+  return r;
+}
+
+int32_t parent_t(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = parent_t_impl(st, i);
+  QL_END(QL_PARENT, i, 0, r);
+  return r;
+}
+
+int32_t depth(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = depth_impl(st, i);
+  QL_END(QL_DEPTH, i, 0, r);
+  return r;
+}
+
+int32_t first_child(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = first_child_impl(st, i);
+  QL_END(QL_FIRST_CHILD, i, 0, r);
+  return r;
+}
+
+int32_t next_sibling(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = next_sibling_impl(st, i);
+  QL_END(QL_NEXT_SIBLING, i, 0, r);
+  return r;
+}
+
+int32_t is_leaf_t(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = is_leaf_t_impl(st, i);
+  QL_END(QL_IS_LEAF, i, 0, r);
+  return r;
+}
+
+int32_t level_next(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = level_next_impl(st, i);
+  QL_END(QL_LEVEL_NEXT, i, 0, r);
+  return r;
+}
+
+int32_t level_prev(rmMt* st, int32_t i) {
+  QL_BEGIN();
+  int32_t r = level_prev_impl(st, i);
+  QL_END(QL_LEVEL_PREV, i, 0, r);
+  return r;
+}
+
+int32_t level_lmost(rmMt* st, int32_t d) {
+  QL_BEGIN();
+  int32_t r = level_lmost_impl(st, d);
+  QL_END(QL_LEVEL_LMOST, d, 0, r);
+  return r;
+}
+
+int32_t level_rmost(rmMt* st, int32_t d) {
+  QL_BEGIN();
+  int32_t r = level_rmost_impl(st, d);
+  QL_END(QL_LEVEL_RMOST, d, 0, r);
+  return r;
+}
+
 ulong size_rmMt(rmMt *st) {
   ulong sizeRmMt = sizeof(rmMt);
   ulong sizeBitArray = st->bit_array->num_of_bits/8;
-  ulong sizePrimes = 3*((st->num_chunks + st->internal_nodes)*sizeof(int16_t)) +
-    st->num_chunks*sizeof(int16_t);
+  ulong sizePrimes = 2*((st->num_chunks + st->internal_nodes)*sizeof(int16_t)) +
+    st->num_chunks*sizeof(int16_t) + n_prime_layout(st, NULL)*sizeof(uint32_t);
 
   return sizeRmMt + sizeBitArray + sizePrimes;
 }
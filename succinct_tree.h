@@ -36,8 +36,12 @@
 
 typedef int32_t depth_t;
 
+#define LOG_S 8 // Default chunks of the min-max trees have 2^LOG_S parentheses
+#define ST_MAX_LEVELS 33 // Levels of a binary min-max tree over 2^32 chunks
+
 struct rmMt_t {
-  unsigned int s; // Chunk size
+  unsigned int s; // Chunk size, s = 2^log_s
+  unsigned int log_s; // Chunk positions are computed with shifts
   unsigned int k; // arity of the min-max tree
   unsigned long n; // number of parentheses
   unsigned int height;
@@ -50,7 +54,19 @@ struct rmMt_t {
   depth_t* e_prime; // num_chunks leaves (it does not need internal nodes)
   depth_t* m_prime; // num_chunks leaves plus internal nodes
   depth_t* M_prime; // num_chunks leaves plus internal nodes
-  int16_t* n_prime; // num_chunks leaves plus internal nodes
+  // n' of leaves and internal nodes, packed by levels: the nodes of level l
+  // use n_width[l] bits from n_level[l] (read them with n_prime_get)
+  uint32_t* n_prime;
+  uint32_t* n_level[ST_MAX_LEVELS];
+  unsigned char n_width[ST_MAX_LEVELS];
+
+  // Lazy construction (st_create_lazy): ready[pos] != 0 iff the internal node
+  // pos has been computed. NULL when all internal nodes were built up front
+  uint8_t* ready;
+
+  // Single allocation that holds e', m', M', n' and the ready flags. NULL if
+  // the arrays belong to a st_builder
+  void* arena;
 
   // Input bitarray
   BIT_ARRAY* bit_array;
@@ -58,8 +74,44 @@ struct rmMt_t {
 
 typedef struct rmMt_t rmMt;
 
-lookup_table *T;
-unsigned int height;
+#define ST_MIN_LOG_S 6
+#define ST_MAX_LOG_S 14 // n' of a chunk must fit in an int16_t
+#define ST_PROFILE_FILE "st_profile" // Default profile (working directory)
+
+// Tunable parameters. They are loaded once, before the first construction,
+// from the file named by the environment variable ST_PROFILE (by default
+// ST_PROFILE_FILE). Profiles are written by st_autotune
+struct st_config_t {
+  unsigned int log_s; // New min-max trees have chunks of 2^log_s parentheses
+  unsigned int build_tasks; // Ranges of chunks per worker in STEP 2.1
+  unsigned int query_tasks; // Parts of a query batch per worker
+  unsigned int interleave; // Queries in flight per part (0: INTERLEAVED_QUERIES)
+  unsigned int workers; // Cilk workers (0: default of the runtime). It only
+			// applies if the runtime has not started yet
+};
+
+typedef struct st_config_t st_config;
+
+extern st_config st_conf;
+
+// It loads the profile (and starts the query log, see query_log.h), only the
+// first time that it is called
+void st_config_init();
+// They return 0 on success and -1 if the file cannot be opened
+int st_config_load(const char* fn, st_config* conf);
+int st_config_save(const char* fn, st_config* conf);
+
+// Universal tables, shared by all the min-max trees
+extern lookup_table *T;
+
+// Reusable builder: it keeps its arena across builds, so repeated builds of
+// similar size do not allocate memory
+struct st_builder_t {
+  void* arena;
+  size_t capacity; // Size of the arena in bytes
+};
+
+typedef struct st_builder_t st_builder;
 
 /* Construction */
 
@@ -67,6 +119,71 @@ rmMt* st_create(BIT_ARRAY* B, unsigned long n);
 rmMt* st_create_emM(BIT_ARRAY* B, unsigned long n);
 rmMt* st_create_il(BIT_ARRAY* B, unsigned long n);
 
+// Lazy construction: only the leaves of the min-max tree are computed (steps
+// 2.1 and 2.2). Internal nodes are computed on first touch by fwd_search and
+// bwd_search. It is safe to query the tree from several threads.
+rmMt* st_create_lazy(BIT_ARRAY* B, unsigned long n);
+
+// Balance of a parentheses sequence
+struct bp_status_t {
+  int balanced; // The excess is never negative and it is zero at the end
+  long first_negative; // First position with negative excess, -1 if none
+  long final_excess;
+};
+
+typedef struct bp_status_t bp_status;
+
+// Like st_create, and it reports the balance of B in status
+rmMt* st_create_checked(BIT_ARRAY* B, unsigned long n, bp_status* status);
+
+// Balance of the sequence of a min-max tree, from e' and the minima of the
+// leaves (O(n/s), without a pass over the bits)
+void st_status(rmMt* st, bp_status* status);
+
+// Standalone validation of B[0, n): blocks are summarized in parallel with
+// the byte tables, and only the block with the first negative excess is
+// scanned again
+void bp_validate(BIT_ARRAY* B, unsigned long n, bp_status* status);
+
+// It computes the internal node pos of a lazy min-max tree (if needed)
+void lazy_build_node(rmMt* st, unsigned int pos);
+
+// Makes sure that the node 'node' of the min-max tree is computed. Children
+// of a computed node are always computed, so it is only needed when moving
+// to a node that is not a descendant of an already touched node
+#define ensure_node(st, node) do {			\
+    if((st)->ready) lazy_build_node((st), (node));	\
+  } while(0)
+
+// Number of minima of the range of node v of the min-max tree (n')
+uint32_t n_prime_get(rmMt* st, unsigned int v);
+
+// It frees a min-max tree (but not its input bit array)
+void st_free(rmMt* st);
+
+// Standalone min-max tree of the subtree of node i (bits [i, find_close(i)]).
+// If i is at the start of a chunk, the leaves are taken from st and only the
+// last chunk is scanned; otherwise the tree is built from scratch. The new
+// bit array (st->bit_array) belongs to the caller
+rmMt* st_extract_subtree(rmMt* st, int32_t i);
+
+// Excess, minimum excess, maximum excess and number of minima of B[lo, hi),
+// relative to the excess before lo (STEP 2.1 on a single chunk)
+void st_chunk_summary(BIT_ARRAY* B, unsigned long lo, unsigned long hi,
+		      depth_t* e, depth_t* m, depth_t* M, int16_t* n);
+
+// It completes a min-max tree (STEPS 2.2 and 2.3) from the summaries of its
+// chunks of 2^log_s parentheses, given by st_chunk_summary
+rmMt* st_create_from_chunks(BIT_ARRAY* B, unsigned long n, unsigned int log_s,
+			    depth_t* e, depth_t* m, depth_t* M,
+			    int16_t* num_mins);
+
+st_builder* st_builder_create();
+// The min-max tree is stored in the arena of the builder, so it is valid
+// until the next build with the same builder or until st_builder_free
+rmMt* st_builder_build(st_builder* builder, BIT_ARRAY* B, unsigned long n);
+void st_builder_free(st_builder* builder);
+
 void print_rmMt(rmMt *);
 
 unsigned long size_rmMt(rmMt *);
@@ -87,6 +204,20 @@ int32_t find_open_semi(rmMt* st, int32_t i);
 // It is defined in the paper of Navarro and Sadakane
 int32_t fwd_search(rmMt* st, int32_t i, int32_t d);
 
+// Implementation of the primitive operation bwd_search(P,\pi,i,d)
+// It returns the largest j <= i such that the excess before j is E(i)-d
+int32_t bwd_search(rmMt* st, int32_t i, int32_t d);
+
+// Steps of fwd_search, used by the batch kernels (batch_queries.h)
+// check_leaf_r: Case 1, the rest of the chunk of i, where excess is the excess
+// value at i (returns i-1 if not found)
+// check_sibling_r: Case 2, the chunk that starts at i (returns i-1 if not found)
+// fwd_search_chunk: Case 3, up and down the min-max tree. It returns the chunk
+// that contains the first excess value 'target' to the right of 'chunk', or -1
+int32_t check_leaf_r(rmMt* st, int32_t i, int32_t target, int32_t excess);
+int32_t check_sibling_r(rmMt* st, int32_t i, int32_t d);
+int32_t fwd_search_chunk(rmMt* st, int32_t chunk, int32_t target);
+
 // Implementation of the primitive operation sum(P,\pi,i,j)
 // It is defined in the paper of Navarro and Sadakane
 // It is equivalent to the depth of the ith node or the excess value at ith position
@@ -126,4 +257,25 @@ int32_t first_child(rmMt* st, int32_t i);
 int32_t next_sibling(rmMt* st, int32_t i);
 int32_t is_leaf_t(rmMt* st, int32_t i);
 
+// Level operations. They return -1 if there is no such node
+// level_next/level_prev: next/previous node with the same depth of node i
+// level_lmost/level_rmost: leftmost/rightmost node with depth d (the roots
+// have depth 1)
+int32_t level_next(rmMt* st, int32_t i);
+int32_t level_prev(rmMt* st, int32_t i);
+int32_t level_lmost(rmMt* st, int32_t d);
+int32_t level_rmost(rmMt* st, int32_t d);
+
+// Level-order traversal of the nodes with depth d, from left to right
+struct level_iterator_t {
+  rmMt* st;
+  int32_t node; // Next node to report, -1 at the end
+};
+
+typedef struct level_iterator_t level_iterator;
+
+void level_iterator_init(level_iterator* it, rmMt* st, int32_t d);
+// It returns the current node and moves to the next one (-1 at the end)
+int32_t level_iterator_next(level_iterator* it);
+
 #endif // SUCCINCT_TREE_H
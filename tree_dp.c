@@ -0,0 +1,357 @@
+/******************************************************************************
+ * tree_dp.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree_dp.h"
+#include "util.h"
+#include "basic.h"
+
+// Blocks per thread when the grain is chosen automatically
+#define TASKS_PER_THREAD 8
+// Gaps of the skeleton of at most INLINE_GAP parentheses are solved during
+// the sequential fold instead of as parallel pieces
+#define INLINE_GAP 512
+
+#define VALUE(base, k) ((char*)(base) + (k)*dp->value_size)
+
+// Workspace of a sweep over at most 'size' nodes
+struct sweep {
+  char* stack;
+  int32_t* nodes;
+  unsigned long* pres;
+};
+
+static void sweep_alloc(tree_dp* dp, struct sweep* w, unsigned long size) {
+  w->stack = (char*)malloc((size+1)*dp->value_size);
+  w->nodes = (int32_t*)malloc((size+1)*sizeof(int32_t));
+  w->pres = (unsigned long*)malloc((size+1)*sizeof(unsigned long));
+}
+
+static void sweep_free(struct sweep* w) {
+  free(w->stack);
+  free(w->nodes);
+  free(w->pres);
+}
+
+// Stack sweep over [from, to), a sequence of complete subtrees whose first
+// node has preorder rank 'pre'. The values of the top-level subtrees are
+// stored in 'values', in order. It returns their number
+static unsigned long solve_range(rmMt* st, tree_dp* dp, int32_t from, int32_t to,
+				 unsigned long pre, void* out, struct sweep* w,
+				 void* values) {
+  unsigned long count = 0;
+  long top = 0;
+
+  for(int32_t p = from; p < to; p++) {
+    if(bit_array_get_bit(st->bit_array, p)) {
+      w->nodes[top] = p;
+      w->pres[top] = pre;
+      dp->init(VALUE(w->stack, top), p, pre, dp->ctx);
+      top++;
+      pre++;
+    }
+    else {
+      top--;
+      void* v = VALUE(w->stack, top);
+      if(dp->finish)
+	dp->finish(v, w->nodes[top], w->pres[top], dp->ctx);
+      if(out)
+	memcpy(VALUE(out, w->pres[top]), v, dp->value_size);
+      if(top > 0)
+	dp->combine(VALUE(w->stack, top-1), v, dp->ctx);
+      else
+	memcpy(VALUE(values, count++), v, dp->value_size);
+    }
+  }
+
+  return count;
+}
+
+/*
+ * Division. The sequence is split in blocks of at most 2*grain parentheses.
+ * A skeleton node (more than 'grain' nodes) spans more than a block, so it
+ * is one of the parentheses that are not matched inside their block. These
+ * are found by a sweep of each block in parallel and matched with a stack
+ * over the blocks. Between two consecutive parentheses of skeleton nodes
+ * there is a gap of complete subtrees of at most 'grain' nodes each, which
+ * is solved in pieces that start at block boundaries (moved to the next
+ * subtree of the gap)
+ */
+
+// Gap of the skeleton. Its top-level subtrees are children of the innermost
+// open skeleton node (or roots of the forest)
+struct gap {
+  int32_t from, to;
+  long first_piece, num_pieces; // No pieces if the gap is solved inline
+};
+
+struct piece {
+  int32_t from, to;
+  char* values; // Values of the top-level subtrees
+  unsigned long count;
+};
+
+// Unmatched parentheses of B[from, to): number of closing parentheses
+// (*closes) and of opening parentheses (*opens)
+static void block_unmatched(rmMt* st, int32_t from, int32_t to, long* closes,
+			    long* opens) {
+  long e = 0, m = 0;
+  for(int32_t p = from; p < to; p++) {
+    e += bit_array_get_bit(st->bit_array, p) ? 1 : -1;
+    m = min(m, e);
+  }
+  *closes = -m;
+  *opens = e - m;
+}
+
+// Positions of the unmatched parentheses of B[from, to). A closing
+// parenthesis is unmatched if it reaches a new minimum excess, and an opening
+// parenthesis if the excess never goes below it again in the block
+static void block_fill(rmMt* st, int32_t from, int32_t to, int32_t* closes,
+		       int32_t* opens, long num_opens) {
+  long e = 0, m = 0, k = 0;
+  for(int32_t p = from; p < to; p++) {
+    e += bit_array_get_bit(st->bit_array, p) ? 1 : -1;
+    if(e < m) {
+      m = e;
+      closes[k++] = p;
+    }
+  }
+
+  // Backwards, with the minimum excess of the suffix after p (e is the
+  // excess at p)
+  long suffix = e;
+  k = num_opens;
+  for(int32_t p = to-1; p >= from && k > 0; p--) {
+    int bit = bit_array_get_bit(st->bit_array, p);
+    if(bit && e <= suffix)
+      opens[--k] = p;
+    suffix = min(suffix, e);
+    e -= bit ? 1 : -1;
+  }
+}
+
+void tree_dp_run(rmMt* st, tree_dp* dp, void* out, void* root, unsigned long grain) {
+  if(grain == 0)
+    grain = max((unsigned long)st->s, st->n/2/(threads*TASKS_PER_THREAD));
+  int32_t n = st->n;
+  int32_t block = (2*grain < (unsigned long)n) ? 2*grain : n;
+  long num_blocks = (n + block - 1)/block;
+
+  /*
+   * STEP 1: Skeleton. Unmatched parentheses of each block, in parallel
+   */
+  long* num_closes = (long*)malloc((num_blocks+1)*sizeof(long));
+  long* num_opens = (long*)malloc((num_blocks+1)*sizeof(long));
+  cilk_for(long b = 0; b < num_blocks; b++)
+    block_unmatched(st, b*block, min((b+1)*block, n), &num_closes[b], &num_opens[b]);
+
+  long total_closes = parallel_prefix_sum((unsigned long*)num_closes, num_blocks);
+  long total_opens = parallel_prefix_sum((unsigned long*)num_opens, num_blocks);
+  num_closes[num_blocks] = total_closes;
+  num_opens[num_blocks] = total_opens;
+
+  int32_t* closes = (int32_t*)malloc((total_closes+1)*sizeof(int32_t));
+  int32_t* opens = (int32_t*)malloc((total_opens+1)*sizeof(int32_t));
+  cilk_for(long b = 0; b < num_blocks; b++)
+    block_fill(st, b*block, min((b+1)*block, n), closes + num_closes[b],
+	       opens + num_opens[b], num_opens[b+1] - num_opens[b]);
+
+  // Matching across blocks. Skeleton nodes are kept in preorder
+  int32_t* match = (int32_t*)malloc((total_opens+1)*sizeof(int32_t));
+  long* stack = (long*)malloc((total_opens+1)*sizeof(long));
+  long top = 0;
+  for(long b = 0; b < num_blocks; b++) {
+    for(long k = num_closes[b]; k < num_closes[b+1] && top > 0; k++)
+      match[stack[--top]] = closes[k];
+    for(long k = num_opens[b]; k < num_opens[b+1]; k++)
+      stack[top++] = k;
+  }
+  while(top > 0) // Unbalanced input
+    match[stack[--top]] = n-1;
+
+  long num_skeleton = 0;
+  for(long k = 0; k < total_opens; k++)
+    if((unsigned long)(match[k] - opens[k] + 1)/2 > grain) {
+      opens[num_skeleton] = opens[k];
+      match[num_skeleton] = match[k];
+      num_skeleton++;
+    }
+
+  free(num_closes);
+  free(num_opens);
+  free(closes);
+
+  /*
+   * STEP 2: Gaps between the parentheses of the skeleton (in order, event e
+   * is an opening parenthesis if it is >= 0 and the closing parenthesis of
+   * skeleton node -e-1 otherwise), and pieces of the long gaps
+   */
+  long* events = (long*)malloc((2*num_skeleton+1)*sizeof(long));
+  long num_events = 0;
+  top = 0;
+  for(long k = 0; k <= num_skeleton; k++) {
+    while(top > 0 && (k == num_skeleton || match[stack[top-1]] < opens[k])) {
+      top--;
+      events[num_events++] = -stack[top]-1;
+    }
+    if(k < num_skeleton) {
+      events[num_events++] = k;
+      stack[top++] = k;
+    }
+  }
+  free(stack);
+
+#define EVENT_POS(e) ((e) >= 0 ? opens[e] : match[-(e)-1])
+
+  struct gap* gaps = (struct gap*)malloc((num_events+1)*sizeof(struct gap));
+  long cap = num_blocks + 1, num_pieces = 0;
+  struct piece* pieces = (struct piece*)malloc(cap*sizeof(struct piece));
+  for(long g = 0; g <= num_events; g++) {
+    struct gap* gp = &gaps[g];
+    gp->from = (g == 0) ? 0 : EVENT_POS(events[g-1]) + 1;
+    gp->to = (g == num_events) ? n : EVENT_POS(events[g]);
+    gp->first_piece = num_pieces;
+    gp->num_pieces = 0;
+    if(gp->to - gp->from <= INLINE_GAP)
+      continue;
+
+    // Cuts at the block boundaries, moved to the next top-level subtree
+    int32_t base = gp->from > 0 ? sum(st, gp->from - 1) : 0;
+    int32_t cut = gp->from;
+    while(cut < gp->to) {
+      int32_t next = (cut/block + 1)*block;
+      if(next < gp->to) {
+	int32_t e = sum(st, next - 1);
+	if(e != base)
+	  next = fwd_search(st, next - 1, base - e + 1) + 1;
+      }
+      next = min(next, gp->to);
+
+      if(num_pieces == cap) {
+	cap *= 2;
+	pieces = (struct piece*)realloc(pieces, cap*sizeof(struct piece));
+      }
+      pieces[num_pieces].from = cut;
+      pieces[num_pieces].to = next;
+      num_pieces++;
+      gp->num_pieces++;
+      cut = next;
+    }
+  }
+
+  /*
+   * STEP 3: The pieces are solved in parallel
+   */
+  cilk_for(long k = 0; k < num_pieces; k++) {
+    struct piece* pc = &pieces[k];
+    unsigned long size = (pc->to - pc->from)/2;
+    struct sweep w;
+    sweep_alloc(dp, &w, size);
+    pc->values = (char*)malloc((size+1)*dp->value_size);
+    pc->count = solve_range(st, dp, pc->from, pc->to, rank_1(st, pc->from) - 1,
+			    out, &w, pc->values);
+    sweep_free(&w);
+  }
+
+  /*
+   * STEP 4: Sequential fold along the events. A skeleton node only costs its
+   * callbacks (chains of skeleton nodes have empty gaps), and short gaps are
+   * swept here
+   */
+  char* values = (char*)malloc((num_skeleton+1)*dp->value_size);
+  unsigned long* pres = (unsigned long*)malloc((num_skeleton+1)*sizeof(unsigned long));
+  char* inline_values = (char*)malloc((INLINE_GAP/2+1)*dp->value_size);
+  struct sweep w;
+  sweep_alloc(dp, &w, INLINE_GAP/2);
+  unsigned long pre = 0;
+  top = 0; // Open skeleton nodes: values[0..top-1]
+
+  for(long g = 0; g <= num_events; g++) {
+    struct gap* gp = &gaps[g];
+
+    // Top-level subtrees of the gap, piece by piece
+    for(long k = 0; k < max(gp->num_pieces, 1); k++) {
+      int32_t from = gp->from;
+      unsigned long count = 0;
+      char* vals = inline_values;
+      if(gp->num_pieces > 0) {
+	struct piece* pc = &pieces[gp->first_piece + k];
+	from = pc->from;
+	count = pc->count;
+	vals = pc->values;
+      }
+      else if(gp->to > gp->from)
+	count = solve_range(st, dp, gp->from, gp->to, pre, out, &w, inline_values);
+
+      if(top > 0)
+	for(unsigned long c = 0; c < count; c++)
+	  dp->combine(VALUE(values, top-1), VALUE(vals, c), dp->ctx);
+      else if(root && from == 0 && count > 0)
+	memcpy(root, vals, dp->value_size);
+    }
+    pre += (gp->to - gp->from)/2;
+
+    if(g == num_events)
+      break;
+
+    long e = events[g];
+    if(e >= 0) { // Opening parenthesis of skeleton node e
+      dp->init(VALUE(values, top), opens[e], pre, dp->ctx);
+      pres[top++] = pre++;
+      continue;
+    }
+
+    // Closing parenthesis of skeleton node -e-1
+    int32_t x = opens[-e-1];
+    top--;
+    void* v = VALUE(values, top);
+    if(dp->finish)
+      dp->finish(v, x, pres[top], dp->ctx);
+    if(out)
+      memcpy(VALUE(out, pres[top]), v, dp->value_size);
+    if(root && x == 0)
+      memcpy(root, v, dp->value_size);
+    if(top > 0)
+      dp->combine(VALUE(values, top-1), v, dp->ctx);
+  }
+
+  for(long k = 0; k < num_pieces; k++)
+    free(pieces[k].values);
+  free(pieces);
+  free(gaps);
+  free(events);
+  free(values);
+  free(pres);
+  free(inline_values);
+  sweep_free(&w);
+  free(opens);
+  free(match);
+}
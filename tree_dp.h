@@ -0,0 +1,64 @@
+/******************************************************************************
+ * tree_dp.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef TREE_DP_H
+#define TREE_DP_H
+
+#include <stddef.h>
+
+#include "succinct_tree.h"
+
+// Bottom-up dynamic programming on the tree of a min-max tree. The value of
+// a node is a post-order fold over its children:
+//   init(v, x) ; combine(v, child) for each child, left to right ; finish(v, x)
+// The nodes of more than 'grain' nodes (the skeleton) are found by sweeping
+// blocks of 2*grain parentheses in parallel. The subtrees between them are
+// solved in parallel with a stack sweep each, and only the callbacks of the
+// skeleton are run sequentially at the end.
+struct tree_dp_t {
+  size_t value_size; // Bytes of the value of a node
+
+  // x is the position of the opening parenthesis of the node, pre its
+  // preorder rank. finish may be NULL
+  void (*init)(void* value, int32_t x, unsigned long pre, void* ctx);
+  void (*combine)(void* value, const void* child, void* ctx);
+  void (*finish)(void* value, int32_t x, unsigned long pre, void* ctx);
+
+  void* ctx; // User data passed to the callbacks
+};
+
+typedef struct tree_dp_t tree_dp;
+
+// It computes the value of every node. If out is not NULL, out must have
+// room for n/2 values and the value of the node with preorder rank k is
+// stored at out + k*value_size. If root is not NULL, the value of the node at
+// position 0 is copied to root. grain = 0 chooses a grain from the number of
+// threads
+void tree_dp_run(rmMt* st, tree_dp* dp, void* out, void* root, unsigned long grain);
+
+#endif // TREE_DP_H
@@ -0,0 +1,187 @@
+/******************************************************************************
+ * trie.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "trie.h"
+#include "util.h"
+#include "basic.h"
+
+/*
+ * Construction
+ *
+ * The nodes of the trie in preorder are the distinct prefixes of the keys in
+ * lexicographic order. Key i adds the prefixes of length lcp_i+1..len_i, where
+ * lcp_i is the longest common prefix with key i-1. In the parentheses, key i
+ * closes the len_{i-1}-lcp_i deepest nodes of key i-1 and opens its new nodes
+ */
+trie* trie_create(char** keys, unsigned long num_keys) {
+  trie* t = (trie*)malloc(sizeof(trie));
+  t->num_keys = num_keys;
+
+  unsigned long* len = (unsigned long*)malloc((num_keys+1)*sizeof(unsigned long));
+  unsigned long* lcp = (unsigned long*)malloc((num_keys+1)*sizeof(unsigned long));
+  unsigned long* node_off = (unsigned long*)malloc((num_keys+1)*sizeof(unsigned long));
+  unsigned long* bp_off = (unsigned long*)malloc((num_keys+1)*sizeof(unsigned long));
+
+  cilk_for(unsigned long i = 0; i < num_keys; i++) {
+    len[i] = strlen(keys[i]);
+    unsigned long l = 0;
+    if(i > 0)
+      while(keys[i-1][l] != '\0' && keys[i-1][l] == keys[i][l])
+	l++;
+    lcp[i] = l;
+  }
+
+  cilk_for(unsigned long i = 0; i < num_keys; i++) {
+    node_off[i] = len[i] - lcp[i]; // New nodes
+    bp_off[i] = ((i > 0)? len[i-1] : 0) - lcp[i] + len[i] - lcp[i];
+  }
+
+  // The root is the node 0 and its opening parenthesis the bit 0
+  t->num_nodes = 1 + parallel_prefix_sum(node_off, num_keys);
+  unsigned long n = 1 + parallel_prefix_sum(bp_off, num_keys) + (num_keys? len[num_keys-1] : 0) + 1;
+
+  t->bp = bit_array_create(n);
+  t->terminal = bit_array_create(t->num_nodes);
+  uint32_t* labels = (uint32_t*)malloc(t->num_nodes*sizeof(uint32_t));
+
+  bit_array_set_bit(t->bp, 0);
+  labels[0] = 0;
+  if(num_keys > 0 && len[0] == 0) // Empty key
+    bit_array_set_bit(t->terminal, 0);
+
+  cilk_for(unsigned long i = 0; i < num_keys; i++) {
+    unsigned long closes = ((i > 0)? len[i-1] : 0) - lcp[i];
+    unsigned long pos = 1 + bp_off[i] + closes; // First opening parenthesis
+    unsigned long node = 1 + node_off[i];
+
+    for(unsigned long d = lcp[i]; d < len[i]; d++, pos++, node++) {
+      parallel_or_bit_array_set_bit(t->bp, pos);
+      labels[node] = (unsigned char)keys[i][d];
+    }
+    if(len[i] > lcp[i])
+      parallel_or_bit_array_set_bit(t->terminal, node-1);
+  }
+
+  t->st = st_create(t->bp, n);
+  t->lt = lt_create(t->st, labels, 256);
+  t->term = rank_bitmap_create(t->terminal, t->num_nodes);
+
+  free(labels);
+  free(len);
+  free(lcp);
+  free(node_off);
+  free(bp_off);
+
+  return t;
+}
+
+void trie_free(trie* t) {
+  lt_free(t->lt);
+  st_free(t->st);
+  rank_bitmap_free(t->term);
+  bit_array_free(t->bp);
+  bit_array_free(t->terminal);
+  free(t);
+}
+
+/*
+ * Operations
+ */
+
+// Node reached by the longest prefix of s present in the trie. *depth is
+// the length of that prefix
+static int32_t descend(trie* t, const char* s, unsigned long* depth) {
+  int32_t x = 0;
+  unsigned long d = 0;
+
+  for(; s[d] != '\0'; d++) {
+    int32_t y = lt_child_by_label(t->lt, x, (unsigned char)s[d]);
+    if(y < 0)
+      break;
+    x = y;
+  }
+
+  *depth = d;
+  return x;
+}
+
+static inline int is_terminal(trie* t, int32_t x) {
+  return bit_array_get_bit(t->terminal, lt_preorder(t->lt, x));
+}
+
+long trie_lookup(trie* t, const char* key) {
+  unsigned long d;
+  int32_t x = descend(t, key, &d);
+
+  if(key[d] != '\0' || !is_terminal(t, x))
+    return -1;
+
+  return rank_bitmap_rank1(t->term, lt_preorder(t->lt, x));
+}
+
+unsigned long trie_prefix_range(trie* t, const char* prefix, unsigned long* first) {
+  unsigned long d;
+  int32_t x = descend(t, prefix, &d);
+
+  *first = 0;
+  if(prefix[d] != '\0')
+    return 0;
+
+  // Keys of the subtree of x
+  *first = rank_bitmap_rank1(t->term, lt_preorder(t->lt, x));
+  unsigned long end = rank_bitmap_rank1(t->lt->bp, find_close(t->st, x));
+
+  return rank_bitmap_rank1(t->term, end) - *first;
+}
+
+long trie_longest_prefix_match(trie* t, const char* s, unsigned long* len) {
+  int32_t x = 0;
+  long id = -1;
+  unsigned long d = 0;
+
+  *len = 0;
+  while(1) {
+    if(is_terminal(t, x)) {
+      id = rank_bitmap_rank1(t->term, lt_preorder(t->lt, x));
+      *len = d;
+    }
+    if(s[d] == '\0')
+      break;
+
+    x = lt_child_by_label(t->lt, x, (unsigned char)s[d]);
+    if(x < 0)
+      break;
+    d++;
+  }
+
+  return id;
+}
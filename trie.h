@@ -0,0 +1,67 @@
+/******************************************************************************
+ * trie.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef TRIE_H
+#define TRIE_H
+
+#include "succinct_tree.h"
+#include "labeled_tree.h"
+#include "rank_bitmap.h"
+
+// Succinct trie for a sorted set of strings. The topology is stored as
+// balanced parentheses (with its min-max tree), the edge labels in preorder
+// as a labeled tree and the nodes where a key ends in a terminal bitmap.
+// Keys are identified by their position in the sorted input
+struct trie_t {
+  unsigned long num_keys;
+  unsigned long num_nodes;
+  BIT_ARRAY* bp;
+  rmMt* st;
+  labeled_tree* lt; // Label of a node: last byte of its prefix
+  BIT_ARRAY* terminal; // terminal[k] = 1 iff the node with preorder k is a key
+  rank_bitmap* term;
+};
+
+typedef struct trie_t trie;
+
+// keys must be sorted (strcmp order) and distinct. The keys are not kept
+trie* trie_create(char** keys, unsigned long num_keys);
+void trie_free(trie* t);
+
+// Identifier of key, or -1 if it is not in the set
+long trie_lookup(trie* t, const char* key);
+
+// Number of keys that start with prefix. Their identifiers are the range
+// [*first, *first + count)
+unsigned long trie_prefix_range(trie* t, const char* prefix, unsigned long* first);
+
+// Identifier of the longest key that is a prefix of s (and its length in
+// *len), or -1 if there is no such key
+long trie_longest_prefix_match(trie* t, const char* s, unsigned long* len);
+
+#endif // TRIE_H
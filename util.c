@@ -62,3 +62,36 @@ BIT_ARRAY* parentheses_to_bits(const char* fn, long* n) {
   return B;
 
 }
+
+#define SCAN_BLOCK 65536
+
+// Exclusive prefix sum of a[0..n-1] in place. It returns the total
+unsigned long parallel_prefix_sum(unsigned long* a, unsigned long n) {
+  unsigned long num_blocks = (n + SCAN_BLOCK - 1)/SCAN_BLOCK;
+  unsigned long* partial = (unsigned long*)malloc((num_blocks+1)*sizeof(unsigned long));
+
+  cilk_for(unsigned long b = 0; b < num_blocks; b++) {
+    unsigned long ul = (b+1)*SCAN_BLOCK < n? (b+1)*SCAN_BLOCK : n, acc = 0;
+    for(unsigned long i = b*SCAN_BLOCK; i < ul; i++) {
+      unsigned long v = a[i];
+      a[i] = acc;
+      acc += v;
+    }
+    partial[b+1] = acc;
+  }
+
+  partial[0] = 0;
+  for(unsigned long b = 1; b <= num_blocks; b++)
+    partial[b] += partial[b-1];
+
+  cilk_for(unsigned long b = 1; b < num_blocks; b++) {
+    unsigned long ul = (b+1)*SCAN_BLOCK < n? (b+1)*SCAN_BLOCK : n;
+    for(unsigned long i = b*SCAN_BLOCK; i < ul; i++)
+      a[i] += partial[b];
+  }
+
+  unsigned long total = partial[num_blocks];
+  free(partial);
+
+  return total;
+}
@@ -30,6 +30,10 @@
 
 BIT_ARRAY* parentheses_to_bits(const char* fn, long* n);
 
+// Exclusive prefix sum of a[0..n-1] in place, computed by blocks in
+// parallel. It returns the total
+unsigned long parallel_prefix_sum(unsigned long* a, unsigned long n);
+
 #ifdef ARCH64
 #define logW 6
 #else
@@ -0,0 +1,170 @@
+/******************************************************************************
+ * wavelet_matrix.c
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavelet_matrix.h"
+#include "util.h"
+#include "basic.h"
+
+// Elements moved by each task of the stable partition
+#define PARTITION_BLOCK 65536
+
+wavelet_matrix* wavelet_matrix_create(uint32_t* seq, unsigned long n, uint32_t sigma) {
+  wavelet_matrix* wm = (wavelet_matrix*)malloc(sizeof(wavelet_matrix));
+  wm->n = n;
+  wm->sigma = sigma;
+  wm->levels = 1;
+  while(wm->levels < 32 && (1UL << wm->levels) < sigma)
+    wm->levels++;
+
+  wm->bits = (BIT_ARRAY**)malloc(wm->levels*sizeof(BIT_ARRAY*));
+  wm->rb = (rank_bitmap**)malloc(wm->levels*sizeof(rank_bitmap*));
+  wm->zeros = (unsigned long*)malloc(wm->levels*sizeof(unsigned long));
+
+  uint32_t* cur = (uint32_t*)malloc(n*sizeof(uint32_t));
+  uint32_t* next = (uint32_t*)malloc(n*sizeof(uint32_t));
+  memcpy(cur, seq, n*sizeof(uint32_t));
+
+  unsigned long num_words = (n + (word_size) - 1)/(word_size);
+  unsigned long num_blocks = (n + PARTITION_BLOCK - 1)/PARTITION_BLOCK;
+
+  for(unsigned int l = 0; l < wm->levels; l++) {
+    unsigned int shift = wm->levels - 1 - l;
+    BIT_ARRAY* B = bit_array_create(n);
+
+    // Each task writes whole words, so no synchronization is needed
+    cilk_for(unsigned long w = 0; w < num_words; w++) {
+      unsigned long ul = min((w+1)*(word_size), n);
+      word_t word = 0;
+      for(unsigned long i = w*(word_size); i < ul; i++)
+	word |= (word_t)((cur[i] >> shift) & 1) << (i - w*(word_size));
+      B->words[w] = word;
+    }
+
+    wm->bits[l] = B;
+    wm->rb[l] = rank_bitmap_create(B, n);
+    wm->zeros[l] = n - wm->rb[l]->ones;
+
+    // Stable partition: the rank of the beginning of each block gives the
+    // output positions of its zeros and ones
+    cilk_for(unsigned long b = 0; b < num_blocks; b++) {
+      unsigned long ll = b*PARTITION_BLOCK, ul = min(ll + PARTITION_BLOCK, n);
+      unsigned long z = rank_bitmap_rank0(wm->rb[l], ll);
+      unsigned long o = wm->zeros[l] + rank_bitmap_rank1(wm->rb[l], ll);
+      for(unsigned long i = ll; i < ul; i++) {
+	if((cur[i] >> shift) & 1)
+	  next[o++] = cur[i];
+	else
+	  next[z++] = cur[i];
+      }
+    }
+
+    uint32_t* tmp = cur;
+    cur = next;
+    next = tmp;
+  }
+
+  free(cur);
+  free(next);
+
+  return wm;
+}
+
+void wavelet_matrix_free(wavelet_matrix* wm) {
+  for(unsigned int l = 0; l < wm->levels; l++) {
+    rank_bitmap_free(wm->rb[l]);
+    bit_array_free(wm->bits[l]);
+  }
+  free(wm->bits);
+  free(wm->rb);
+  free(wm->zeros);
+  free(wm);
+}
+
+uint32_t wavelet_matrix_access(wavelet_matrix* wm, unsigned long i) {
+  uint32_t c = 0;
+
+  for(unsigned int l = 0; l < wm->levels; l++) {
+    unsigned int bit = bit_array_get_bit(wm->bits[l], i);
+    c = (c << 1) | bit;
+    if(bit)
+      i = wm->zeros[l] + rank_bitmap_rank1(wm->rb[l], i);
+    else
+      i = rank_bitmap_rank0(wm->rb[l], i);
+  }
+
+  return c;
+}
+
+// It maps the range [*start, *end) of the first level to the range of symbol
+// c in the last level
+static inline void descend(wavelet_matrix* wm, uint32_t c, unsigned long* start, unsigned long* end) {
+  for(unsigned int l = 0; l < wm->levels; l++) {
+    if((c >> (wm->levels - 1 - l)) & 1) {
+      *start = wm->zeros[l] + rank_bitmap_rank1(wm->rb[l], *start);
+      *end = wm->zeros[l] + rank_bitmap_rank1(wm->rb[l], *end);
+    }
+    else {
+      *start = rank_bitmap_rank0(wm->rb[l], *start);
+      *end = rank_bitmap_rank0(wm->rb[l], *end);
+    }
+  }
+}
+
+unsigned long wavelet_matrix_rank(wavelet_matrix* wm, uint32_t c, unsigned long i) {
+  if(c >= wm->sigma)
+    return 0;
+
+  unsigned long start = 0, end = min(i, wm->n);
+  descend(wm, c, &start, &end);
+
+  return end - start;
+}
+
+unsigned long wavelet_matrix_select(wavelet_matrix* wm, uint32_t c, unsigned long k) {
+  if(c >= wm->sigma || k == 0)
+    return wm->n;
+
+  unsigned long start = 0, end = wm->n;
+  descend(wm, c, &start, &end);
+  if(k > end - start)
+    return wm->n;
+
+  // Go up from the k-th position of the range of c
+  unsigned long pos = start + k - 1;
+  for(int l = wm->levels - 1; l >= 0; l--) {
+    if((c >> (wm->levels - 1 - l)) & 1)
+      pos = rank_bitmap_select1(wm->rb[l], pos - wm->zeros[l] + 1);
+    else
+      pos = rank_bitmap_select0(wm->rb[l], pos + 1);
+  }
+
+  return pos;
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * wavelet_matrix.h
+ *
+ * Parallel construction of succinct trees
+ * For more information: http://www.inf.udec.cl/~josefuentes/sea2015/
+ *
+ ******************************************************************************
+ * Copyright (C) 2015 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef WAVELET_MATRIX_H
+#define WAVELET_MATRIX_H
+
+#include <stdint.h>
+
+#include "rank_bitmap.h"
+
+// Wavelet matrix over a sequence of symbols in [0, sigma). Level l stores bit
+// (levels-1-l) of each symbol, after stably moving the symbols with a 0 in
+// the previous levels' bits to the front. Each level is built in parallel
+struct wavelet_matrix_t {
+  unsigned long n;
+  uint32_t sigma;
+  unsigned int levels; // ceil(log2(sigma))
+  BIT_ARRAY** bits;
+  rank_bitmap** rb;
+  unsigned long* zeros; // Number of zeros of each level
+};
+
+typedef struct wavelet_matrix_t wavelet_matrix;
+
+wavelet_matrix* wavelet_matrix_create(uint32_t* seq, unsigned long n, uint32_t sigma);
+void wavelet_matrix_free(wavelet_matrix* wm);
+
+// Symbol at position i
+uint32_t wavelet_matrix_access(wavelet_matrix* wm, unsigned long i);
+
+// Number of occurrences of symbol c in [0, i)
+unsigned long wavelet_matrix_rank(wavelet_matrix* wm, uint32_t c, unsigned long i);
+
+// Position of the k-th occurrence of symbol c (k >= 1), or n if there is no
+// such occurrence
+unsigned long wavelet_matrix_select(wavelet_matrix* wm, uint32_t c, unsigned long k);
+
+#endif // WAVELET_MATRIX_H